@@ -49,10 +49,10 @@
  */
 
 /*  We assume that high level application like pdf viewers will want
- *  to embed this code as is. We assume that they also have locale.h and setlocale.
+ *  to embed this code as is. Floats are parsed without locale.h nor setlocale.
  *  For other tools such as TeXLive tools, you must define SYNCTEX_USE_LOCAL_HEADER,
  *  when building. You also have to create and customize synctex_parser_local.h to fit your system.
- *  In particular, the HAVE_LOCALE_H and HAVE_SETLOCALE macros should be properly defined.
+ *  The HAVE_LOCALE_H and HAVE_SETLOCALE macros it may define are no longer used.
  *  With this design, you should not need to edit this file. */
 
 /**
@@ -92,8 +92,6 @@
 #if defined(SYNCTEX_USE_LOCAL_HEADER)
 #include "synctex_parser_local.h"
 #else
-#define HAVE_LOCALE_H 1
-#define HAVE_SETLOCALE 1
 #if defined(_MSC_VER)
 #define SYNCTEX_INLINE __inline
 #else
@@ -104,14 +102,11 @@
 #include <errno.h>
 #include <limits.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-#if defined(HAVE_LOCALE_H)
-#include <locale.h>
-#endif
-
 /* Mark unused parameters, so that there will be no compile warnings. */
 #ifdef __DARWIN_UNIX03
 #define SYNCTEX_UNUSED(x) SYNCTEX_PRAGMA(unused(x))
@@ -432,10 +427,13 @@ static SYNCTEX_INLINE synctex_node_p _synctex_new_handle_with_target(synctex_nod
     }
 #endif
 
+/*  Links are arena indices, see NODE ALLOCATION. */
+static SYNCTEX_INLINE synctex_node_p _synctex_node_at(synctex_node_p node, synctex_index_t index);
+
 #define DEFINE_SYNCTEX_TREE__GET(WHAT)                                                                                                                         \
     static SYNCTEX_INLINE synctex_node_p __synctex_tree_##WHAT(synctex_non_null_node_p node)                                                                   \
     {                                                                                                                                                          \
-        return node->data[node->class_->navigator->WHAT].as_node;                                                                                              \
+        return _synctex_node_at(node, node->data[node->class_->navigator->WHAT].as_index);                                                                     \
     }
 #define DEFINE_SYNCTEX_TREE_GET(WHAT)                                                                                                                          \
     DEFINE_SYNCTEX_TREE__GET(WHAT);                                                                                                                            \
@@ -449,8 +447,8 @@ static SYNCTEX_INLINE synctex_node_p _synctex_new_handle_with_target(synctex_nod
 #define DEFINE_SYNCTEX_TREE__RESET(WHAT)                                                                                                                       \
     static SYNCTEX_INLINE synctex_node_p __synctex_tree_reset_##WHAT(synctex_non_null_node_p node)                                                             \
     {                                                                                                                                                          \
-        synctex_node_p old = node->data[node->class_->navigator->WHAT].as_node;                                                                                \
-        node->data[node->class_->navigator->WHAT].as_node = NULL;                                                                                              \
+        synctex_node_p old = __synctex_tree_##WHAT(node);                                                                                                      \
+        node->data[node->class_->navigator->WHAT].as_index = 0;                                                                                                \
         return old;                                                                                                                                            \
     }
 #define DEFINE_SYNCTEX_TREE_RESET(WHAT)                                                                                                                        \
@@ -463,7 +461,7 @@ static SYNCTEX_INLINE synctex_node_p _synctex_new_handle_with_target(synctex_nod
     static SYNCTEX_INLINE synctex_node_p __synctex_tree_set_##WHAT(synctex_non_null_node_p node, synctex_node_p new_value)                                     \
     {                                                                                                                                                          \
         synctex_node_p old = __synctex_tree_##WHAT(node);                                                                                                      \
-        node->data[node->class_->navigator->WHAT].as_node = new_value;                                                                                         \
+        node->data[node->class_->navigator->WHAT].as_index = new_value ? new_value->index : 0;                                                                 \
         return old;                                                                                                                                            \
     }
 #define DEFINE_SYNCTEX_TREE_SET(WHAT)                                                                                                                          \
@@ -968,6 +966,35 @@ DEFINE_SYNCTEX_TREE_GETSETRESET(target);
 #include <zlib.h>
 #endif
 
+/*  Uncompressed synctex files are memory mapped when possible.
+ *  Define SYNCTEX_USE_MMAP to 0 to always use the buffered reader. */
+#if !defined(SYNCTEX_USE_MMAP)
+#if defined(_WIN32) || !(defined(__unix__) || defined(__APPLE__))
+#define SYNCTEX_USE_MMAP 0
+#else
+#define SYNCTEX_USE_MMAP 1
+#endif
+#endif
+#if SYNCTEX_USE_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*  The content of the sheets is parsed by several threads when the parse options ask for it.
+ *  Define SYNCTEX_USE_THREADS to 0 to always parse it on the calling thread. */
+#if !defined(SYNCTEX_USE_THREADS)
+#if defined(_WIN32) || !(defined(__unix__) || defined(__APPLE__)) || defined(SYNCTEX_USE_HANDLE) || SYNCTEX_USE_NODE_COUNT > 0
+#define SYNCTEX_USE_THREADS 0
+#else
+#define SYNCTEX_USE_THREADS 1
+#endif
+#endif
+#if SYNCTEX_USE_THREADS
+#include <pthread.h>
+#endif
+
 #ifdef SYNCTEX_NOTHING
 #pragma mark -
 #pragma mark STATUS
@@ -1002,6 +1029,594 @@ DEFINE_SYNCTEX_TREE_GETSETRESET(target);
 #if SYNCTEX_BUFFER_SIZE < SYNCTEX_BUFFER_MIN_SIZE
 #error BAD BUFFER SIZE(2)
 #endif
+
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark Gzip checkpoint index
+#endif
+
+/*  Compressed synctex files are not read with gzread but with our own inflater.
+ *  While the file is read for the first time, the inflater records checkpoints
+ *  at deflate block boundaries, roughly every SYNCTEX_ZINDEX_SPAN uncompressed bytes.
+ *  Each checkpoint stores the compressed and uncompressed offsets, the bit offset
+ *  and the 32K dictionary inflate needs to restart at that location.
+ *  Then seeking backwards costs at most SYNCTEX_ZINDEX_SPAN inflated bytes
+ *  instead of inflating the file again from its beginning.
+ *  This is the technique of zran.c, from the zlib examples.
+ *  When SYNCTEX_ZINDEX_SIDECAR is defined, a complete index is saved next to the synctex file
+ *  and reused as long as the synctex file does not change.
+ */
+#if !defined(SYNCTEX_ZINDEX_SPAN)
+#define SYNCTEX_ZINDEX_SPAN (1L << 20)
+#endif
+#define SYNCTEX_ZINDEX_WINDOW 32768
+#define SYNCTEX_ZINDEX_CHUNK 16384
+
+#if defined(SYNCTEX_ZINDEX_SIDECAR)
+#include <sys/stat.h>
+#define SYNCTEX_ZINDEX_SUFFIX ".zidx"
+#define SYNCTEX_ZINDEX_MAGIC "SyncTeX zindex:1\n"
+#endif
+
+/**
+ * @brief A location where inflation can restart.
+ */
+typedef struct {
+    /** offset in the uncompressed data */
+    z_off_t out;
+    /** offset in the compressed file of the first full byte */
+    z_off_t in;
+    /** number of bits (1-7) of the byte at in-1 that belong to the next block, or 0 */
+    int bits;
+    /** length of the dictionary */
+    unsigned length;
+    /** the dictionary, the uncompressed data before out */
+    unsigned char *window;
+} _synctex_zpoint_s;
+
+/**
+ * @brief Data structure for the compressed file inflater and its index.
+ */
+typedef struct _synctex_zindex_t {
+    /** the compressed file */
+    FILE *file;
+    /** the inflate stream */
+    z_stream strm;
+    /** whether the stream is in raw deflate mode, after a checkpoint was restored */
+    synctex_bool_t raw;
+    /** Z_OK while reading, Z_STREAM_END at the end of the file, an error otherwise */
+    int status;
+    /** number of compressed bytes read from the file so far */
+    z_off_t read;
+    /** number of uncompressed bytes delivered so far */
+    z_off_t out;
+    /** the checkpoints, sorted by out */
+    _synctex_zpoint_s *list;
+    /** number of checkpoints */
+    int have;
+    /** capacity of the list */
+    int size;
+#if defined(SYNCTEX_ZINDEX_SIDECAR)
+    /** the sidecar file name */
+    char *sidecar;
+    /** the size of the compressed file */
+    long long file_size;
+    /** the modification date of the compressed file */
+    long long file_time;
+    /** whether the index was loaded from the sidecar */
+    synctex_bool_t loaded;
+#endif
+    /** the compressed input buffer */
+    unsigned char input[SYNCTEX_ZINDEX_CHUNK];
+} _synctex_zindex_s;
+
+typedef _synctex_zindex_s *synctex_zindex_p;
+
+/*  Record a checkpoint at the current location of the stream,
+ *  which is a deflate block boundary.
+ */
+static void _synctex_zindex_add_point(synctex_zindex_p z)
+{
+    _synctex_zpoint_s *point;
+    if (z->have == z->size) {
+        int size = z->size ? 2 * z->size : 16;
+        _synctex_zpoint_s *list = realloc(z->list, size * sizeof(_synctex_zpoint_s));
+        if (NULL == list) {
+            /*  Not a fatal error, the index is just less efficient. */
+            return;
+        }
+        z->list = list;
+        z->size = size;
+    }
+    point = z->list + z->have;
+    if (NULL == (point->window = malloc(SYNCTEX_ZINDEX_WINDOW))) {
+        return;
+    }
+    point->length = 0;
+    if (Z_OK != inflateGetDictionary(&z->strm, point->window, &point->length)) {
+        free(point->window);
+        return;
+    }
+    point->out = z->out;
+    point->in = z->read - z->strm.avail_in;
+    point->bits = z->strm.data_type & 7;
+    ++z->have;
+}
+
+/*  Fill the input buffer, when empty.
+ *  - returns: the number of available compressed bytes, 0 at the end of the file.
+ */
+static unsigned _synctex_zindex_fill(synctex_zindex_p z)
+{
+    if (z->strm.avail_in == 0) {
+        z->strm.avail_in = (uInt)fread(z->input, 1, SYNCTEX_ZINDEX_CHUNK, z->file);
+        z->strm.next_in = z->input;
+        z->read += z->strm.avail_in;
+        if (ferror(z->file)) {
+            z->status = Z_ERRNO;
+            z->strm.avail_in = 0;
+        }
+    }
+    return z->strm.avail_in;
+}
+
+/*  Called when inflate reaches the end of a gzip member.
+ *  Steps over the trailer when in raw mode,
+ *  then prepares the stream for the next member, if any.
+ *  Trailing garbage is ignored, like gzread does.
+ */
+static void _synctex_zindex_next_member(synctex_zindex_p z)
+{
+    if (z->raw) {
+        unsigned trailer = 8;
+        while (trailer) {
+            unsigned n;
+            if (0 == _synctex_zindex_fill(z)) {
+                if (z->status == Z_OK) {
+                    z->status = Z_BUF_ERROR;
+                }
+                return;
+            }
+            n = z->strm.avail_in < trailer ? z->strm.avail_in : trailer;
+            z->strm.next_in += n;
+            z->strm.avail_in -= n;
+            trailer -= n;
+        }
+    }
+    if (0 == _synctex_zindex_fill(z) || 0x1f != *z->strm.next_in) {
+        if (z->status == Z_OK) {
+            z->status = Z_STREAM_END;
+        }
+        return;
+    }
+    inflateReset2(&z->strm, 15 + 32);
+    z->raw = synctex_NO;
+}
+
+/*  Read at most len uncompressed bytes in buf, like gzread.
+ *  Checkpoints are recorded on the fly.
+ *  - returns: the number of bytes read, 0 at the end of the file, -1 on error.
+ */
+static int _synctex_zindex_read(synctex_zindex_p z, void *buf, unsigned len)
+{
+    int ret = Z_OK;
+    z->strm.next_out = buf;
+    z->strm.avail_out = len;
+    while (z->strm.avail_out && z->status == Z_OK) {
+        uInt avail_out = z->strm.avail_out;
+        _synctex_zindex_fill(z);
+        if (z->status != Z_OK) {
+            break;
+        }
+        ret = inflate(&z->strm, Z_BLOCK);
+        z->out += avail_out - z->strm.avail_out;
+        if (ret == Z_NEED_DICT) {
+            ret = Z_DATA_ERROR;
+        }
+        /*  Z_BUF_ERROR: no progress is possible, the file is truncated. */
+        if (ret == Z_MEM_ERROR || ret == Z_DATA_ERROR || ret == Z_BUF_ERROR) {
+            z->status = ret;
+            break;
+        }
+        if (ret == Z_STREAM_END) {
+            _synctex_zindex_next_member(z);
+            continue;
+        }
+        /*  At the end of a block which is not the last one? */
+        if ((z->strm.data_type & 128) && !(z->strm.data_type & 64)
+            && (z->have ? z->out - z->list[z->have - 1].out >= SYNCTEX_ZINDEX_SPAN : z->out >= SYNCTEX_ZINDEX_SPAN)) {
+            _synctex_zindex_add_point(z);
+        }
+    }
+    len -= z->strm.avail_out;
+    /*  Like gzread, a truncated file just ends,
+     *  but errors of the file system are reported with Z_ERRNO. */
+    if (len == 0 && z->status != Z_OK && z->status != Z_STREAM_END && z->status != Z_BUF_ERROR) {
+        return -1;
+    }
+    return (int)len;
+}
+
+/*  The message associated to the last error, like gzerror. */
+static const char *_synctex_zindex_error(synctex_zindex_p z, int *errnum)
+{
+    *errnum = z->status == Z_STREAM_END ? Z_OK : z->status;
+    if (z->status == Z_BUF_ERROR) {
+        return "unexpected end of file";
+    }
+    return z->strm.msg ? z->strm.msg : "";
+}
+
+/*  Skip forwards in the uncompressed data, up to the given offset.
+ *  - returns: the new offset.
+ */
+static z_off_t _synctex_zindex_skip(synctex_zindex_p z, z_off_t offset)
+{
+    unsigned char discard[SYNCTEX_ZINDEX_CHUNK];
+    while (z->out < offset) {
+        z_off_t n = offset - z->out;
+        if (_synctex_zindex_read(z, discard, n < SYNCTEX_ZINDEX_CHUNK ? (unsigned)n : SYNCTEX_ZINDEX_CHUNK) <= 0) {
+            break;
+        }
+    }
+    return z->out;
+}
+
+/*  Set the uncompressed offset, like gzseek with SEEK_SET.
+ *  Backwards, inflation restarts at the closest checkpoint before offset.
+ *  - returns: the new offset, -1 on error.
+ */
+static z_off_t _synctex_zindex_seek(synctex_zindex_p z, z_off_t offset)
+{
+    int lo = 0, hi = z->have;
+    _synctex_zpoint_s *point = NULL;
+    /*  Like gzseek, a corrupted stream is not read again. */
+    if (offset < 0 || z->status == Z_DATA_ERROR || z->status == Z_MEM_ERROR) {
+        return -1;
+    }
+    /*  Find the last checkpoint with point->out <= offset. */
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (z->list[mid].out <= offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    point = lo ? z->list + lo - 1 : NULL;
+    if (z->status == Z_OK && offset >= z->out && (NULL == point || point->out <= z->out)) {
+        /*  Going forwards, no checkpoint to jump to. */
+        return _synctex_zindex_skip(z, offset) == offset ? offset : -1;
+    }
+    z->strm.avail_in = 0;
+    z->status = Z_OK;
+    if (point) {
+        int c = 0;
+        if (fseek(z->file, point->in - (point->bits ? 1 : 0), SEEK_SET)) {
+            return -1;
+        }
+        inflateReset2(&z->strm, -15);
+        z->raw = synctex_YES;
+        if (point->bits) {
+            if (EOF == (c = getc(z->file))) {
+                return -1;
+            }
+            inflatePrime(&z->strm, point->bits, c >> (8 - point->bits));
+        }
+        inflateSetDictionary(&z->strm, point->window, point->length);
+        z->read = point->in;
+        z->out = point->out;
+    } else {
+        if (fseek(z->file, 0, SEEK_SET)) {
+            return -1;
+        }
+        inflateReset2(&z->strm, 15 + 32);
+        z->raw = synctex_NO;
+        z->read = 0;
+        z->out = 0;
+    }
+    return _synctex_zindex_skip(z, offset) == offset ? offset : -1;
+}
+
+#if defined(SYNCTEX_ZINDEX_SIDECAR)
+/*  Load the checkpoints from the sidecar file, if it matches the compressed file.
+ */
+static void _synctex_zindex_load(synctex_zindex_p z)
+{
+    FILE *F = NULL;
+    long long size = 0, time = 0, span = 0;
+    int have = 0;
+    char magic[sizeof(SYNCTEX_ZINDEX_MAGIC)];
+    if (NULL == (F = fopen(z->sidecar, "rb"))) {
+        return;
+    }
+    if (fread(magic, 1, sizeof(magic) - 1, F) != sizeof(magic) - 1 || strncmp(magic, SYNCTEX_ZINDEX_MAGIC, sizeof(magic) - 1)
+        || fscanf(F, "%lld %lld %lld %i%*c", &size, &time, &span, &have) != 4 || size != z->file_size || time != z->file_time
+        || span != SYNCTEX_ZINDEX_SPAN || have <= 0 || NULL == (z->list = _synctex_malloc(have * sizeof(_synctex_zpoint_s)))) {
+        fclose(F);
+        return;
+    }
+    z->size = have;
+    while (z->have < have) {
+        _synctex_zpoint_s *point = z->list + z->have;
+        long long out = 0, in = 0;
+        if (fscanf(F, "%lld %lld %i %u%*c", &out, &in, &point->bits, &point->length) != 4 || point->length > SYNCTEX_ZINDEX_WINDOW
+            || NULL == (point->window = malloc(SYNCTEX_ZINDEX_WINDOW)) || fread(point->window, 1, point->length, F) != point->length) {
+            break;
+        }
+        point->out = (z_off_t)out;
+        point->in = (z_off_t)in;
+        ++z->have;
+    }
+    fclose(F);
+    if (z->have < have) {
+        /*  Corrupted sidecar, forget everything. */
+        while (z->have) {
+            free(z->list[--z->have].window);
+        }
+        _synctex_free(z->list);
+        z->list = NULL;
+        z->size = 0;
+        return;
+    }
+    z->loaded = synctex_YES;
+}
+/*  Save the checkpoints in the sidecar file, once the whole file has been indexed.
+ */
+static void _synctex_zindex_save(synctex_zindex_p z)
+{
+    FILE *F = NULL;
+    int i = 0;
+    if (z->loaded || z->status != Z_STREAM_END || z->have == 0 || NULL == (F = fopen(z->sidecar, "wb"))) {
+        return;
+    }
+    fputs(SYNCTEX_ZINDEX_MAGIC, F);
+    fprintf(F, "%lld %lld %lld %i\n", z->file_size, z->file_time, (long long)SYNCTEX_ZINDEX_SPAN, z->have);
+    for (i = 0; i < z->have; ++i) {
+        _synctex_zpoint_s *point = z->list + i;
+        fprintf(F, "%lld %lld %i %u\n", (long long)point->out, (long long)point->in, point->bits, point->length);
+        fwrite(point->window, 1, point->length, F);
+    }
+    if (fclose(F)) {
+        remove(z->sidecar);
+    }
+    z->loaded = synctex_YES;
+}
+#endif
+
+/*  Create an inflater for the compressed file at the given path.
+ *  - returns: NULL on error.
+ */
+static synctex_zindex_p _synctex_zindex_new(const char *path)
+{
+    synctex_zindex_p z = NULL;
+    if (NULL == path || NULL == (z = _synctex_malloc(sizeof(_synctex_zindex_s)))) {
+        return NULL;
+    }
+    if (NULL == (z->file = fopen(path, "rb"))) {
+        _synctex_free(z);
+        return NULL;
+    }
+    if (Z_OK != inflateInit2(&z->strm, 15 + 32)) {
+        fclose(z->file);
+        _synctex_free(z);
+        return NULL;
+    }
+    z->status = Z_OK;
+#if defined(SYNCTEX_ZINDEX_SIDECAR)
+    {
+        struct stat st;
+        if (!stat(path, &st) && (z->sidecar = _synctex_merge_strings(path, SYNCTEX_ZINDEX_SUFFIX, NULL))) {
+            z->file_size = (long long)st.st_size;
+            z->file_time = (long long)st.st_mtime;
+            _synctex_zindex_load(z);
+        }
+    }
+#endif
+    return z;
+}
+
+static void _synctex_zindex_free(synctex_zindex_p z)
+{
+    if (z) {
+#if defined(SYNCTEX_ZINDEX_SIDECAR)
+        if (z->sidecar) {
+            _synctex_zindex_save(z);
+            free(z->sidecar);
+        }
+#endif
+        while (z->have) {
+            free(z->list[--z->have].window);
+        }
+        _synctex_free(z->list);
+        inflateEnd(&z->strm);
+        fclose(z->file);
+        _synctex_free(z);
+    }
+}
+
+#if SYNCTEX_USE_THREADS
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark Inflater thread
+#endif
+
+/*  When the parse options ask for it, a compressed synctex file is inflated
+ *  on another thread while the calling thread parses it.
+ *  The inflater thread fills a ring of slots and waits when they are all full,
+ *  the parser empties them and waits when they are all empty.
+ *  Slots are much larger than the buffer of the reader, such that locks are rare.
+ *  The pipe only reads forwards: seeking stops the thread
+ *  and the inflater is used directly again.
+ */
+#if !defined(SYNCTEX_PIPE_SLOTS)
+#define SYNCTEX_PIPE_SLOTS 4
+#endif
+#if !defined(SYNCTEX_PIPE_SLOT_SIZE)
+#define SYNCTEX_PIPE_SLOT_SIZE (1L << 18)
+#endif
+
+typedef struct {
+    /** the inflated bytes */
+    unsigned char *bytes;
+    /** number of inflated bytes, 0 at the end of the file, -1 on error */
+    int length;
+} _synctex_pipe_slot_s;
+
+/**
+ * @brief Data structure for the inflater thread and its ring of slots.
+ */
+typedef struct _synctex_pipe_t {
+    /** the inflater, owned by the thread while it runs */
+    synctex_zindex_p zindex;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    /** signaled when a slot is filled or emptied, or when the thread should stop */
+    pthread_cond_t cond;
+    _synctex_pipe_slot_s slots[SYNCTEX_PIPE_SLOTS];
+    /** number of slots filled so far, by the thread */
+    unsigned produced;
+    /** number of slots emptied so far, by the parser */
+    unsigned consumed;
+    /** number of bytes of the first filled slot already read */
+    int offset;
+    /** number of uncompressed bytes delivered to the parser */
+    z_off_t out;
+    /** whether the thread should stop */
+    synctex_bool_t stop;
+} _synctex_pipe_s;
+
+typedef _synctex_pipe_s *synctex_pipe_p;
+
+/*  The inflater thread, it stops at the end of the file or on error. */
+static void *_synctex_pipe_inflate(void *arg)
+{
+    synctex_pipe_p pipe = arg;
+    int length = 1;
+    pthread_mutex_lock(&pipe->mutex);
+    while (length > 0) {
+        _synctex_pipe_slot_s *slot = NULL;
+        while (!pipe->stop && pipe->produced - pipe->consumed == SYNCTEX_PIPE_SLOTS) {
+            pthread_cond_wait(&pipe->cond, &pipe->mutex);
+        }
+        if (pipe->stop) {
+            break;
+        }
+        slot = pipe->slots + pipe->produced % SYNCTEX_PIPE_SLOTS;
+        pthread_mutex_unlock(&pipe->mutex);
+        length = _synctex_zindex_read(pipe->zindex, slot->bytes, SYNCTEX_PIPE_SLOT_SIZE);
+        pthread_mutex_lock(&pipe->mutex);
+        slot->length = length;
+        ++pipe->produced;
+        pthread_cond_signal(&pipe->cond);
+    }
+    pthread_mutex_unlock(&pipe->mutex);
+    return NULL;
+}
+
+/*  Read at most len uncompressed bytes in buf, like _synctex_zindex_read.
+ *  Less than len bytes are read only at the end of the file.
+ *  - returns: the number of bytes read, 0 at the end of the file, -1 on error.
+ */
+static int _synctex_pipe_read(synctex_pipe_p pipe, void *buf, unsigned len)
+{
+    unsigned n = 0;
+    while (n < len) {
+        _synctex_pipe_slot_s *slot = NULL;
+        unsigned available = 0;
+        if (0 == pipe->offset) {
+            pthread_mutex_lock(&pipe->mutex);
+            while (pipe->produced == pipe->consumed) {
+                pthread_cond_wait(&pipe->cond, &pipe->mutex);
+            }
+            pthread_mutex_unlock(&pipe->mutex);
+        }
+        slot = pipe->slots + pipe->consumed % SYNCTEX_PIPE_SLOTS;
+        if (slot->length <= 0) {
+            /*  The last slot is never emptied, the next reads end there too. */
+            if (0 == n && slot->length < 0) {
+                return -1;
+            }
+            break;
+        }
+        available = (unsigned)(slot->length - pipe->offset);
+        if (available > len - n) {
+            available = len - n;
+        }
+        memcpy((char *)buf + n, slot->bytes + pipe->offset, available);
+        n += available;
+        pipe->offset += available;
+        if (pipe->offset == slot->length) {
+            pipe->offset = 0;
+            pthread_mutex_lock(&pipe->mutex);
+            ++pipe->consumed;
+            pthread_cond_signal(&pipe->cond);
+            pthread_mutex_unlock(&pipe->mutex);
+        }
+    }
+    pipe->out += n;
+    return (int)n;
+}
+
+/*  Stop the thread and free the slots.
+ *  The inflater is then located after the last filled slot, not at pipe->out.
+ */
+static void _synctex_pipe_free(synctex_pipe_p pipe)
+{
+    if (pipe) {
+        int i = 0;
+        pthread_mutex_lock(&pipe->mutex);
+        pipe->stop = synctex_YES;
+        pthread_cond_signal(&pipe->cond);
+        pthread_mutex_unlock(&pipe->mutex);
+        pthread_join(pipe->thread, NULL);
+        pthread_cond_destroy(&pipe->cond);
+        pthread_mutex_destroy(&pipe->mutex);
+        for (i = 0; i < SYNCTEX_PIPE_SLOTS; ++i) {
+            free(pipe->slots[i].bytes);
+        }
+        _synctex_free(pipe);
+    }
+}
+
+/*  Start inflating on another thread, from the current location of the inflater.
+ *  - returns: NULL on error.
+ */
+static synctex_pipe_p _synctex_pipe_new(synctex_zindex_p zindex)
+{
+    synctex_pipe_p pipe = NULL;
+    int i = 0;
+    if (NULL == zindex || NULL == (pipe = _synctex_malloc(sizeof(_synctex_pipe_s)))) {
+        return NULL;
+    }
+    pipe->zindex = zindex;
+    pipe->out = zindex->out;
+    for (i = 0; i < SYNCTEX_PIPE_SLOTS; ++i) {
+        if (NULL == (pipe->slots[i].bytes = malloc(SYNCTEX_PIPE_SLOT_SIZE))) {
+            goto return_on_error;
+        }
+    }
+    if (pthread_mutex_init(&pipe->mutex, NULL)) {
+        goto return_on_error;
+    }
+    if (pthread_cond_init(&pipe->cond, NULL)) {
+        pthread_mutex_destroy(&pipe->mutex);
+        goto return_on_error;
+    }
+    if (pthread_create(&pipe->thread, NULL, &_synctex_pipe_inflate, pipe)) {
+        pthread_cond_destroy(&pipe->cond);
+        pthread_mutex_destroy(&pipe->mutex);
+        goto return_on_error;
+    }
+    return pipe;
+return_on_error:
+    for (i = 0; i < SYNCTEX_PIPE_SLOTS; ++i) {
+        free(pipe->slots[i].bytes);
+    }
+    _synctex_free(pipe);
+    return NULL;
+}
+#endif
 /** @endcond */
 
 /**
@@ -1029,6 +1644,16 @@ typedef struct _synctex_reader_t {
     int lastv;
     /** Undocumented */
     int line_number;
+    /** length of the memory mapping, 0 when the file is buffered */
+    size_t mapped;
+    /** whether the "mapping" is the content read into memory, see _synctex_reader_load */
+    synctex_bool_t loaded;
+    /** the inflater of a compressed file, replaces file */
+    synctex_zindex_p zindex;
+#if SYNCTEX_USE_THREADS
+    /** the inflater thread, reads zindex ahead of the parser, see _synctex_reader_pipe */
+    synctex_pipe_p pipe;
+#endif
     SYNCTEX_DECLARE_CHAR_OFFSET
 } _synctex_reader_s;
 
@@ -1214,79 +1839,430 @@ static _synctex_open_s _synctex_open_v2(const char *output, const char *build_di
     } /* if (build_directory...) */
     return open;
 }
-static void synctex_reader_free(synctex_reader_p reader)
+/*  The next functions hide whether the file is read with gzread
+ *  or with the inflater of the gzip checkpoint index.
+ */
+static synctex_bool_t _synctex_reader_is_open(synctex_reader_p reader)
 {
-    if (reader) {
-        _synctex_free(reader->output);
-        _synctex_free(reader->synctex);
-        _synctex_free(reader->start);
-        gzclose(reader->file);
-        _synctex_free(reader);
-    }
+    return reader->file || reader->zindex;
 }
-/*
- *  Returns true on success, returns false on failure
- %  (the reader is NULL, the output is NULL or empty, there is a malloc error).
- */
-static synctex_bool_t synctex_reader_init_with_output_file(synctex_reader_p reader, const char *output, const char *build_directory)
+static int _synctex_reader_read(synctex_reader_p reader, void *buf, unsigned len)
 {
-    if (reader) {
-        /*  now open the synctex file */
-        _synctex_open_s open = _synctex_open_v2(output, build_directory, 0, synctex_ADD_QUOTES);
-        if (open.status < SYNCTEX_STATUS_OK) {
-            open = _synctex_open_v2(output, build_directory, 0, synctex_DONT_ADD_QUOTES);
-            if (open.status < SYNCTEX_STATUS_OK) {
-                return synctex_NO;
-            }
-        }
-        reader->synctex = open.synctex;
-        reader->file = open.file;
-        /*  make a private copy of output */
-        if (NULL == (reader->output = (char *)_synctex_malloc(strlen(output)+1))){
-            _synctex_error("!  synctex_reader_init_with_output_file: Memory problem (2), reader's output is not reliable.");
-        } else if (reader->output != strcpy(reader->output,output)) {
-            _synctex_free(reader->output);
-            reader->output = NULL;
-            _synctex_error("!  synctex_reader_init_with_output_file: Copy problem, reader's output is not reliable.");
-        }
-        reader->start = reader->end = reader->current = NULL;
-        reader->min_size = SYNCTEX_BUFFER_MIN_SIZE;
-        reader->size = SYNCTEX_BUFFER_SIZE;
-        reader->start = reader->current = (char *)_synctex_malloc(reader->size + 1); /*  one more character for null termination */
-        if (NULL == reader->start) {
-            _synctex_error("!  synctex_reader_init_with_output_file: malloc problem (2).");
-            return synctex_NO;
-        }
-        reader->end = reader->start + reader->size;
-        /*  reader->end always points to a null terminating character.
-         *  Maybe there is another null terminating character between reader->current and reader->end-1.
-         *  At least, we are sure that reader->current points to a string covering a valid part of the memory. */
-#if defined(SYNCTEX_USE_CHARINDEX)
-        reader->charindex_offset = -reader->size;
+#if SYNCTEX_USE_THREADS
+    if (reader->pipe) {
+        return _synctex_pipe_read(reader->pipe, buf, len);
+    }
 #endif
+    return reader->zindex ? _synctex_zindex_read(reader->zindex, buf, len) : gzread(reader->file, buf, len);
+}
+static const char *_synctex_reader_error(synctex_reader_p reader, int *errnum)
+{
+    return reader->zindex ? _synctex_zindex_error(reader->zindex, errnum) : gzerror(reader->file, errnum);
+}
+static z_off_t _synctex_reader_tell(synctex_reader_p reader)
+{
+#if SYNCTEX_USE_THREADS
+    if (reader->pipe) {
+        return reader->pipe->out;
     }
-    return synctex_YES;
+#endif
+    return reader->zindex ? reader->zindex->out : reader->file ? gztell(reader->file) : -1;
 }
-
-/** @cond */
-
-#if defined(SYNCTEX_USE_HANDLE)
-#define SYNCTEX_DECLARE_HANDLE synctex_node_p handle;
+/*  Stop the inflater thread, if any.
+ *  The inflater is ahead of the parser, it must be seeked before the next read.
+ */
+static void _synctex_reader_unpipe(synctex_reader_p reader)
+{
+#if SYNCTEX_USE_THREADS
+    _synctex_pipe_free(reader->pipe);
+    reader->pipe = NULL;
 #else
-#define SYNCTEX_DECLARE_HANDLE
-#endif
-
-#ifdef SYNCTEX_NOTHING
-#pragma mark -
-#pragma mark SCANNER
+    SYNCTEX_UNUSED(reader)
 #endif
-
+}
+static z_off_t _synctex_reader_seek(synctex_reader_p reader, z_off_t offset)
+{
+    _synctex_reader_unpipe(reader);
+    return reader->zindex ? _synctex_zindex_seek(reader->zindex, offset) : reader->file ? gzseek(reader->file, offset, SEEK_SET) : -1;
+}
+static void _synctex_reader_close(synctex_reader_p reader)
+{
+    _synctex_reader_unpipe(reader);
+    if (reader->file) {
+        gzclose(reader->file);
+        reader->file = NULL;
+    }
+    _synctex_zindex_free(reader->zindex);
+    reader->zindex = NULL;
+}
+/*  Replace gzread by the inflater of the gzip checkpoint index,
+ *  when the file is compressed.
+ *  - returns: yorn
+ */
+static synctex_bool_t _synctex_reader_index(synctex_reader_p reader)
+{
+    if (reader->file && !gzdirect(reader->file) && (reader->zindex = _synctex_zindex_new(reader->synctex))) {
+        gzclose(reader->file);
+        reader->file = NULL;
+        return synctex_YES;
+    }
+    return synctex_NO;
+}
+#if SYNCTEX_USE_THREADS
+/*  Inflate the compressed file on another thread while it is parsed.
+ *  Nothing is done when the file is not read with the inflater of the checkpoint index.
+ *  - returns: yorn
+ */
+static synctex_bool_t _synctex_reader_pipe(synctex_reader_p reader)
+{
+    if (reader->zindex && NULL == reader->pipe) {
+        reader->pipe = _synctex_pipe_new(reader->zindex);
+    }
+    return NULL != reader->pipe;
+}
+#endif
+/*  Map the whole synctex file into memory, when it is not compressed.
+ *  The mapping is one byte longer than the file, the bytes beyond the file contents are 0,
+ *  such that reader->end points to a null terminating character, like in the buffered mode.
+ *  On success, reader->start covers the whole file, reader->size is the file size,
+ *  reader->mapped is the length of the mapping and the gz file is closed.
+ *  On failure, the reader is left untouched and the buffered mode is used.
+ *  - returns: yorn
+ */
+static synctex_bool_t _synctex_reader_map(synctex_reader_p reader)
+{
+#if SYNCTEX_USE_MMAP
+    int fd = -1;
+    struct stat st;
+    size_t length = 0;
+    char *map = MAP_FAILED;
+    if (!reader->file || !reader->synctex || !gzdirect(reader->file)) {
+        return synctex_NO;
+    }
+    if ((fd = open(reader->synctex, O_RDONLY)) < 0) {
+        return synctex_NO;
+    }
+    if (fstat(fd, &st) || st.st_size <= 0 || (unsigned long long)st.st_size >= (unsigned long long)UINT_MAX) {
+        close(fd);
+        return synctex_NO;
+    }
+    length = (size_t)st.st_size + 1;
+    /*  Reserve zero filled anonymous memory, then map the file over its head. */
+    map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        return synctex_NO;
+    }
+    if (mmap(map, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(map, length);
+        close(fd);
+        return synctex_NO;
+    }
+    close(fd);
+#if defined(MADV_SEQUENTIAL)
+    madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+    gzclose(reader->file);
+    reader->file = NULL;
+    reader->mapped = length;
+    reader->size = (size_t)st.st_size;
+    reader->start = reader->current = map;
+    reader->end = reader->start + reader->size;
+    return synctex_YES;
+#else
+    SYNCTEX_UNUSED(reader)
+    return synctex_NO;
+#endif
+}
+/*  Balance _synctex_reader_map or free the buffer.
+ */
+static void _synctex_reader_free_buffer(synctex_reader_p reader)
+{
+#if SYNCTEX_USE_MMAP
+    if (reader->mapped && !reader->loaded) {
+        munmap(reader->start, reader->mapped);
+        reader->mapped = 0;
+        reader->start = reader->current = reader->end = NULL;
+        return;
+    }
+#endif
+    _synctex_free(reader->start);
+    reader->start = reader->current = reader->end = NULL;
+    reader->mapped = 0;
+    reader->loaded = synctex_NO;
+}
+/*  Read the whole uncompressed content of the synctex file into memory,
+ *  such that it is shared like a mapped file by the threads parsing the sheets.
+ *  On failure, the reader is rewound and the buffered mode is used.
+ *  - returns: yorn, yes when the file is already mapped.
+ */
+static synctex_bool_t _synctex_reader_load(synctex_reader_p reader)
+{
+    size_t capacity = SYNCTEX_BUFFER_SIZE;
+    size_t size = 0;
+    char *content = NULL;
+    int n = 0;
+    if (reader->mapped) {
+        return synctex_YES;
+    }
+    if (!_synctex_reader_is_open(reader) || NULL == (content = malloc(capacity + 1))) {
+        return synctex_NO;
+    }
+    while ((n = _synctex_reader_read(reader, content + size, (unsigned)(capacity - size))) > 0) {
+        if ((size += n) == capacity) {
+            char *more = capacity < UINT_MAX / 2 ? realloc(content, 2 * capacity + 1) : NULL;
+            if (NULL == more) {
+                n = -1;
+                break;
+            }
+            content = more;
+            capacity *= 2;
+        }
+    }
+    if (n < 0) {
+        free(content);
+        _synctex_reader_seek(reader, 0);
+        return synctex_NO;
+    }
+    content[size] = '\0';
+    _synctex_free(reader->start);
+    _synctex_reader_close(reader);
+    reader->start = reader->current = content;
+    reader->end = content + size;
+    reader->size = size;
+    reader->mapped = size + 1;
+    reader->loaded = synctex_YES;
+#if defined(SYNCTEX_USE_CHARINDEX)
+    reader->charindex_offset = 0;
+#endif
+    return synctex_YES;
+}
+static void synctex_reader_free(synctex_reader_p reader)
+{
+    if (reader) {
+        _synctex_free(reader->output);
+        _synctex_free(reader->synctex);
+        _synctex_reader_free_buffer(reader);
+        _synctex_reader_close(reader);
+        _synctex_free(reader);
+    }
+}
+/*
+ *  Returns true on success, returns false on failure
+ %  (the reader is NULL, the output is NULL or empty, there is a malloc error).
+ */
+static synctex_bool_t synctex_reader_init_with_output_file(synctex_reader_p reader, const char *output, const char *build_directory)
+{
+    if (reader) {
+        /*  now open the synctex file */
+        _synctex_open_s open = _synctex_open_v2(output, build_directory, 0, synctex_ADD_QUOTES);
+        if (open.status < SYNCTEX_STATUS_OK) {
+            open = _synctex_open_v2(output, build_directory, 0, synctex_DONT_ADD_QUOTES);
+            if (open.status < SYNCTEX_STATUS_OK) {
+                return synctex_NO;
+            }
+        }
+        reader->synctex = open.synctex;
+        reader->file = open.file;
+        /*  make a private copy of output */
+        if (NULL == (reader->output = (char *)_synctex_malloc(strlen(output)+1))){
+            _synctex_error("!  synctex_reader_init_with_output_file: Memory problem (2), reader's output is not reliable.");
+        } else if (reader->output != strcpy(reader->output,output)) {
+            _synctex_free(reader->output);
+            reader->output = NULL;
+            _synctex_error("!  synctex_reader_init_with_output_file: Copy problem, reader's output is not reliable.");
+        }
+        reader->start = reader->end = reader->current = NULL;
+        reader->min_size = SYNCTEX_BUFFER_MIN_SIZE;
+        reader->mapped = 0;
+        if (_synctex_reader_map(reader)) {
+            /*  No buffer, the parser works directly on the mapped file. */
+#if defined(SYNCTEX_USE_CHARINDEX)
+            reader->charindex_offset = 0;
+#endif
+            return synctex_YES;
+        }
+        _synctex_reader_index(reader);
+        reader->size = SYNCTEX_BUFFER_SIZE;
+        reader->start = reader->current = (char *)_synctex_malloc(reader->size + 1); /*  one more character for null termination */
+        if (NULL == reader->start) {
+            _synctex_error("!  synctex_reader_init_with_output_file: malloc problem (2).");
+            return synctex_NO;
+        }
+        reader->end = reader->start + reader->size;
+        /*  reader->end always points to a null terminating character.
+         *  Maybe there is another null terminating character between reader->current and reader->end-1.
+         *  At least, we are sure that reader->current points to a string covering a valid part of the memory. */
+#if defined(SYNCTEX_USE_CHARINDEX)
+        reader->charindex_offset = -reader->size;
+#endif
+    }
+    return synctex_YES;
+}
+
+/** @cond */
+
+#if defined(SYNCTEX_USE_HANDLE)
+#define SYNCTEX_DECLARE_HANDLE synctex_node_p handle;
+#else
+#define SYNCTEX_DECLARE_HANDLE
+#endif
+
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark SCANNER
+#endif
+
+/**
+ *  An entry of the sheet directory.
+ *  When parsing lazily, the content of a sheet is skipped
+ *  and parsed on demand from the recorded location.
+ */
+typedef struct {
+    /** The sheet, NULL once its content is parsed */
+    synctex_node_p sheet;
+    /** Offset of the line following the sheet record, in the uncompressed file */
+    z_off_t offset;
+    /** Line number at that offset */
+    int line_number;
+    /** Last v value decoded before that offset, for the "=" shortcut */
+    int lastv;
+} _synctex_sheet_entry_s;
+
+/*  The geometry store of a sheet, used by edit queries. */
+typedef struct _synctex_geometry_t *_synctex_geometry_p;
+
+/**
+ *  A directory of sheets by page, or of forms or inputs by tag.
+ *  Pages and tags are consecutive from 1 in synctex files,
+ *  the nodes are stored in an array indexed by the key.
+ *  Keys too big for this array are not stored and the directory is sparse:
+ *  the sibling list is then browsed for the keys not found.
+ */
+typedef struct {
+    /** The node of each key, NULL if none */
+    synctex_node_p *nodes;
+    /** The index plus 1 of the sheet entry of each key, 0 if none, see _synctex_directory_set_entry */
+    int *entries;
+    /** The geometry store of the sheet of each key, NULL if not yet built, see _synctex_directory_set_geometry */
+    _synctex_geometry_p *geometries;
+    /** The number of allocated nodes */
+    int capacity;
+    /** The number of stored nodes */
+    int count;
+    /** Whether some node could not be stored */
+    synctex_bool_t sparse;
+    /** The last node of the sibling list, to append new ones */
+    synctex_node_p last;
+} _synctex_directory_s;
+
+/**
+ *  An entry of the name index:
+ *  the first input of the input list with a given name, or with a given base name.
+ *  Names are compared with _synctex_is_equivalent_file_name.
+ */
+typedef struct {
+    /** The _synctex_file_name_hash of the name */
+    unsigned int hash;
+    /** Whether the name is a base name */
+    synctex_bool_t base;
+    /** For a base name, whether a following input has the same base name but another name */
+    synctex_bool_t ambiguous;
+    /** The input, NULL when the entry is not used */
+    synctex_node_p input;
+} _synctex_name_entry_s;
+
+/**
+ *  An entry of the friend index.
+ *  The nodes with the same tag and line are linked through their friend field,
+ *  the entry points to the first one.
+ */
+typedef struct {
+    int tag;
+    int line;
+    /** The first friend, NULL when the entry is not used */
+    synctex_node_p node;
+} _synctex_friend_s;
+
+/**
+ *  An entry of the table used to count the friends among the children of a box.
+ *  The entry is used when its stamp is the one of the current box.
+ */
+typedef struct {
+    int tag;
+    int line;
+    int count;
+    unsigned int stamp;
+} _synctex_tally_s;
+
+/**
+ *  A child of the box whose friends are counted, with the index of its tally entry.
+ */
+typedef struct {
+    synctex_node_p node;
+    unsigned int slot;
+} _synctex_sibling_s;
+
+/**
+ *  A root proxy of a sheet, replacing a form ref,
+ *  with a hierarchy not yet registered.
+ */
+typedef struct {
+    /** The form containing the target of the proxy */
+    synctex_node_p form;
+    synctex_node_p proxy;
+} _synctex_proxy_entry_s;
+
+/**
+ *  Nodes are allocated in slabs owned by the scanner,
+ *  one pool for each node size.
+ *  Freed nodes are recycled by their pool,
+ *  the slabs are released all at once with the scanner.
+ */
+typedef struct {
+    /** The size of the nodes */
+    size_t size;
+    /*  alignment, the nodes follow */
+    void *reserved;
+} _synctex_slab_s;
+
+typedef struct {
+    /** The size of the nodes */
+    size_t size;
+    /** The number of nodes in the next slab */
+    size_t capacity;
+    /** The first node never used in the last slab */
+    char *available;
+    /** The end of the last slab */
+    char *end;
+    /** The freed nodes, linked through their first bytes */
+    void *recycled;
+    /** The index of the first node never used in the last slab */
+    synctex_index_t index;
+} _synctex_pool_s;
+
+/*  The R-trees of a sheet, over its horizontal boxes and over its other nodes:
+ *  16 children per node, at most 16^8 leaves.
+ *  Edit queries first collect the boxes containing the hit point
+ *  in an array of SYNCTEX_RTREE_FOUND_MAX entries, malloced when too small. */
+#define SYNCTEX_RTREE_FANOUT 16
+#define SYNCTEX_RTREE_MAX_LEVEL 8
+#define SYNCTEX_RTREE_FOUND_MAX 64
+
 /**
  *  The synctex scanner is the root object.
  *
  *  Is is initialized with the contents of a text file or a gzipped file.
  *  The buffer_.* are first used to parse the text.
  */
+#if SYNCTEX_USE_THREADS
+/*  The slab table of a scanner, shared with the workers parsing its sheets */
+typedef struct _synctex_slab_table_t {
+    pthread_mutex_t mutex;
+    synctex_scanner_p owner;
+} _synctex_slab_table_s;
+#endif
+
 struct _synctex_scanner_t {
     /** Auxiliary reader object discarded when used */
     synctex_reader_p reader;
@@ -1298,14 +2274,26 @@ struct _synctex_scanner_t {
     synctex_iterator_p iterator;
     /** allways 1, not yet used */
     int version;
+    /** decimal integer parser, see synctex_parse_options_s */
+    synctex_parse_int_f parse_int;
+    /** number of threads parsing the content of the sheets, see synctex_parse_options_s */
+    int threads;
     /** various flags */
     struct {
         /**  Whether the scanner has parsed its underlying synctex file. */
         unsigned has_parsed : 1;
         /*  Whether the scanner has parsed the postamble. */
         unsigned postamble : 1;
+        /*  Whether the content of the sheets is parsed on demand. */
+        unsigned lazy : 1;
+        /*  Whether queries no longer modify the scanner, see synctex_scanner_freeze. */
+        unsigned frozen : 1;
+        /*  Whether friends are registered afterwards by another scanner, see _synctex_scanner_parse_sheets_in_parallel. */
+        unsigned deferred : 1;
+        /*  Whether a compressed file is inflated on another thread, see synctex_parse_options_s. */
+        unsigned pipeline : 1;
         /*  alignment */
-        unsigned reserved : sizeof(unsigned) - 2;
+        unsigned reserved : 8 * sizeof(unsigned) - 6;
     } flags;
     /** magnification from the synctex preamble */
     int pre_magnification;
@@ -1329,14 +2317,119 @@ struct _synctex_scanner_t {
     synctex_node_p sheet;
     /** The first form, its siblings are the other forms */
     synctex_node_p form;
+    /** The sheets by page */
+    _synctex_directory_s sheet_by_page;
+    /** The forms by tag */
+    _synctex_directory_s form_by_tag;
+    /** The inputs by tag */
+    _synctex_directory_s input_by_tag;
+    /** The inputs by name, an open addressing table built by the first tag lookup */
+    struct {
+        /** The entries, one for the name and one for the base name of each input */
+        _synctex_name_entry_s *entries;
+        /** The number of entries, a power of 2 */
+        int capacity;
+        /** The first input when the table was built */
+        synctex_node_p input;
+    } names;
     /** The first form ref node in sheet, its friends are the other form ref nodes */
     synctex_node_p ref_in_sheet;
     /** The first form ref node, its friends are the other form ref nodes in sheet */
     synctex_node_p ref_in_form;
-    /** The number of friend lists */
-    int number_of_lists;
-    /** The friend lists */
-    synctex_node_r lists_of_friends;
+    /** The friend index, an open addressing table keyed by tag and line */
+    struct {
+        /** The entries */
+        _synctex_friend_s *entries;
+        /** The number of used entries */
+        int count;
+        /** The number of entries, a power of 2 */
+        int capacity;
+    } friends;
+    /** The keys of the friend index sorted by tag then line, the mapped lines of the inputs, built once all the sheets are parsed */
+    struct {
+        /** The entries, their node is not used */
+        _synctex_friend_s *entries;
+        /** The number of entries, the number of keys in the friend index when up to date */
+        int count;
+    } lines;
+    /** The root proxies of the sheets with a hierarchy not yet registered, sorted by form */
+    struct {
+        /** The entries */
+        _synctex_proxy_entry_s *entries;
+        /** The number of entries */
+        int count;
+        /** The number of allocated entries */
+        int capacity;
+        /** Whether entries were added since they were sorted, see _synctex_scanner_sort_proxies */
+        synctex_bool_t unsorted;
+    } proxies;
+    /** The tags and lines used in the forms, sorted, the node of an entry is the form */
+    struct {
+        /** The entries */
+        _synctex_friend_s *entries;
+        /** The number of entries */
+        int count;
+        /** The last form when the entries were collected */
+        synctex_node_p last;
+    } form_lines;
+    /** A scratch table to count the friends among the children of a box */
+    struct {
+        /** The entries */
+        _synctex_tally_s *entries;
+        /** The number of entries, a power of 2 */
+        int capacity;
+        /** The stamp of the last box */
+        unsigned int stamp;
+        /** The children of the box */
+        _synctex_sibling_s *children;
+        /** The number of allocated children */
+        int count;
+    } siblings;
+    /** The friends to register afterwards, in order, see flags.deferred */
+    struct {
+        /** The entries */
+        _synctex_friend_s *entries;
+        /** The number of entries */
+        int count;
+        /** The number of allocated entries */
+        int capacity;
+    } deferred;
+    /** The sheet directory, only used when parsing lazily */
+    struct {
+        /** where the content of each sheet starts */
+        _synctex_sheet_entry_s *entries;
+        /** The number of entries */
+        int count;
+        /** The number of allocated entries */
+        int capacity;
+        /** The number of sheets not yet parsed */
+        int pending;
+    } sheets;
+    /** The geometry stores of the sheets, built by edit queries */
+    _synctex_geometry_p geometry;
+    /** The node allocator */
+    struct {
+        /** The pools, one for each node size */
+        _synctex_pool_s pools[synctex_node_number_of_types];
+        /** The number of pools */
+        int count;
+        /** The pool of each node type, 0 when not yet known, index + 1 otherwise */
+        int pool_of[synctex_node_number_of_types];
+        /** The expected number of nodes, from the file size */
+        size_t hint;
+        /** The slabs of all the pools, by creation order */
+        _synctex_slab_s **slabs;
+        /** The number of slabs */
+        int slab_count;
+        /** The number of allocated slabs */
+        int slab_capacity;
+        /** The number of leading slabs owned by another scanner, see _synctex_scanner_new_results */
+        int shared;
+#if SYNCTEX_USE_THREADS
+        /** The table where the slabs are added instead, see _synctex_scanner_parse_sheets_in_parallel */
+        _synctex_slab_table_s *table;
+#endif
+    } arena;
     /** The classes of the nodes of the scanner */
     _synctex_class_s class_[synctex_node_number_of_types];
     /** The display switcher value*/
@@ -1347,6 +2440,176 @@ struct _synctex_scanner_t {
 
 /** @endcond */
 
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark NODE ALLOCATION
+#endif
+
+/*  The index of a node is made of the 1 based index of its slab
+ *  in the high bits and its position in that slab in the low bits,
+ *  such that 32 bits links can replace pointers in the nodes.
+ */
+#define SYNCTEX_SLAB_SHIFT 16
+#define SYNCTEX_SLAB_MIN_CAPACITY 64
+#define SYNCTEX_SLAB_MAX_CAPACITY (1 << SYNCTEX_SLAB_SHIFT)
+#define SYNCTEX_SLAB_MAX_COUNT ((1 << (8 * sizeof(synctex_index_t) - SYNCTEX_SLAB_SHIFT)) - 1)
+/*  Average length of a record in an uncompressed synctex file,
+ *  gzip compresses by a factor of 8 at least. */
+#define SYNCTEX_BYTES_PER_RECORD 24
+#define SYNCTEX_GZ_RATIO 8
+
+/*  The expected number of nodes,
+ *  from the postamble when already parsed or from the file size.
+ */
+static size_t _synctex_scanner_node_hint(synctex_scanner_p scanner)
+{
+    if (scanner->flags.postamble && scanner->count > 0) {
+        return (size_t)scanner->count;
+    }
+    if (0 == scanner->arena.hint) {
+        synctex_reader_p reader = scanner->reader;
+        struct stat st;
+        size_t size = 0;
+        if (reader->mapped) {
+            size = reader->size;
+        } else if (reader->synctex && 0 == stat(reader->synctex, &st) && st.st_size > 0) {
+            size = (size_t)st.st_size * SYNCTEX_GZ_RATIO;
+        }
+        scanner->arena.hint = size / SYNCTEX_BYTES_PER_RECORD + 1;
+    }
+    return scanner->arena.hint;
+}
+/*  The pool of nodes of the given type, created on first use. */
+static _synctex_pool_s *_synctex_scanner_pool(synctex_scanner_p scanner, synctex_node_type_t type, size_t size)
+{
+    int i = scanner->arena.pool_of[type];
+    if (0 == i) {
+        for (i = 0; i < scanner->arena.count; ++i) {
+            if (scanner->arena.pools[i].size == size) {
+                break;
+            }
+        }
+        if (i == scanner->arena.count) {
+            size_t capacity = _synctex_scanner_node_hint(scanner) / 8;
+            ++scanner->arena.count;
+            scanner->arena.pools[i].size = size;
+            scanner->arena.pools[i].capacity = capacity < SYNCTEX_SLAB_MIN_CAPACITY   ? SYNCTEX_SLAB_MIN_CAPACITY
+                                               : capacity > SYNCTEX_SLAB_MAX_CAPACITY ? SYNCTEX_SLAB_MAX_CAPACITY
+                                                                                      : capacity;
+        }
+        scanner->arena.pool_of[type] = ++i;
+    }
+    return scanner->arena.pools + i - 1;
+}
+/*  Append the slab to the slab table of the scanner.
+ *  Workers append to the table of their owner instead, which is large enough.
+ *  - returns: the 1 based index of the slab, 0 on failure.
+ */
+static int _synctex_scanner_add_slab(synctex_scanner_p scanner, _synctex_slab_s *slab)
+{
+#if SYNCTEX_USE_THREADS
+    if (scanner->arena.table) {
+        int number;
+        pthread_mutex_lock(&scanner->arena.table->mutex);
+        number = _synctex_scanner_add_slab(scanner->arena.table->owner, slab);
+        pthread_mutex_unlock(&scanner->arena.table->mutex);
+        return number;
+    }
+#endif
+    if (scanner->arena.slab_count == scanner->arena.slab_capacity) {
+        int capacity = scanner->arena.slab_capacity ? 2 * scanner->arena.slab_capacity : 32;
+        _synctex_slab_s **slabs;
+        if (scanner->arena.slab_count == SYNCTEX_SLAB_MAX_COUNT) {
+            return 0;
+        }
+        if (capacity > SYNCTEX_SLAB_MAX_COUNT) {
+            capacity = SYNCTEX_SLAB_MAX_COUNT;
+        }
+        if (NULL == (slabs = realloc(scanner->arena.slabs, capacity * sizeof(_synctex_slab_s *)))) {
+            return 0;
+        }
+        scanner->arena.slabs = slabs;
+        scanner->arena.slab_capacity = capacity;
+    }
+    scanner->arena.slabs[scanner->arena.slab_count++] = slab;
+    return scanner->arena.slab_count;
+}
+/*  Allocate a zero filled node of the given type and size.
+ *  The first slabs of a pool are small when the file is small,
+ *  the next ones are bigger and bigger.
+ *  - returns: the node, NULL on allocation failure.
+ */
+static synctex_node_p _synctex_scanner_new_node(synctex_scanner_p scanner, synctex_node_type_t type, size_t size)
+{
+    _synctex_pool_s *pool = _synctex_scanner_pool(scanner, type, size);
+    synctex_node_p node = NULL;
+    if (pool->recycled) {
+        /*  the first bytes are overwritten by the recycled list,
+         *  not the index. */
+        synctex_index_t index;
+        node = pool->recycled;
+        memcpy(&pool->recycled, node, sizeof(void *));
+        index = node->index;
+        memset(node, 0, pool->size);
+        node->index = index;
+    } else {
+        if (pool->available == pool->end) {
+            _synctex_slab_s *slab;
+            int number;
+            /*  calloc: the nodes are zero filled */
+            slab = calloc(1, sizeof(_synctex_slab_s) + pool->capacity * pool->size);
+            if (NULL == slab) {
+                return NULL;
+            }
+            slab->size = pool->size;
+            if (0 == (number = _synctex_scanner_add_slab(scanner, slab))) {
+                free(slab);
+                return NULL;
+            }
+            pool->index = (synctex_index_t)number << SYNCTEX_SLAB_SHIFT;
+            pool->available = (char *)(slab + 1);
+            pool->end = pool->available + pool->capacity * pool->size;
+            pool->capacity *= 2;
+            if (pool->capacity > SYNCTEX_SLAB_MAX_CAPACITY) {
+                pool->capacity = SYNCTEX_SLAB_MAX_CAPACITY;
+            }
+        }
+        node = (synctex_node_p)pool->available;
+        node->index = pool->index++;
+        pool->available += pool->size;
+    }
+    return node;
+}
+/*  The node at the given index in the arena of the given node,
+ *  NULL for index 0.
+ */
+static SYNCTEX_INLINE synctex_node_p _synctex_node_at(synctex_node_p node, synctex_index_t index)
+{
+    if (index) {
+        _synctex_slab_s *slab = node->class_->scanner->arena.slabs[(index >> SYNCTEX_SLAB_SHIFT) - 1];
+        return (synctex_node_p)((char *)(slab + 1) + (index & (SYNCTEX_SLAB_MAX_CAPACITY - 1)) * slab->size);
+    }
+    return NULL;
+}
+/*  Give the node back to its pool. */
+static void _synctex_node_dispose(synctex_node_p node)
+{
+    synctex_scanner_p scanner = node->class_->scanner;
+    _synctex_pool_s *pool = scanner->arena.pools + scanner->arena.pool_of[node->class_->type] - 1;
+    memcpy(node, &pool->recycled, sizeof(void *));
+    pool->recycled = node;
+}
+/*  Release all the nodes at once. */
+static void _synctex_scanner_free_slabs(synctex_scanner_p scanner)
+{
+    int i;
+    for (i = scanner->arena.shared; i < scanner->arena.slab_count; ++i) {
+        free(scanner->arena.slabs[i]);
+    }
+    free(scanner->arena.slabs);
+    memset(&scanner->arena, 0, sizeof(scanner->arena));
+}
+
 /**
  * @brief Create a new node of the given type.
  *
@@ -1442,7 +2705,7 @@ static void _synctex_free_node(synctex_node_p node)
             }
             SYNCTEX_SCANNER_REMOVE_HANDLE_TO(node);
             SYNCTEX_WILL_FREE(node);
-            _synctex_free(node);
+            _synctex_node_dispose(node);
             node = sibling;
             goto find_deepest;
         } else {
@@ -1451,7 +2714,7 @@ static void _synctex_free_node(synctex_node_p node)
                 __synctex_tree_reset_child(parent);
                 SYNCTEX_SCANNER_REMOVE_HANDLE_TO(node);
                 SYNCTEX_WILL_FREE(node);
-                _synctex_free(node);
+                _synctex_node_dispose(node);
                 /* The parent is now the deepest node */
                 if (parent != top_parent) {
                     node = parent;
@@ -1461,7 +2724,7 @@ static void _synctex_free_node(synctex_node_p node)
             } else {
                 SYNCTEX_SCANNER_REMOVE_HANDLE_TO(node);
                 SYNCTEX_WILL_FREE(node);
-                _synctex_free(node);
+                _synctex_node_dispose(node);
                 /* The parent is now the deepest node */
             }
         }
@@ -1513,12 +2776,12 @@ static void _synctex_free_handle(synctex_node_p handle)
     right:
         nn = __synctex_tree_sibling(n);
         if (nn) {
-            _synctex_free(n);
+            _synctex_node_dispose(n);
             n = nn;
             goto down;
         }
         nn = __synctex_tree_parent(n);
-        _synctex_free(n);
+        _synctex_node_dispose(n);
         if (nn) {
             n = nn;
             goto right;
@@ -1540,7 +2803,7 @@ static void _synctex_free_leaf(synctex_node_p node)
         SYNCTEX_SCANNER_REMOVE_HANDLE_TO(node);
         SYNCTEX_WILL_FREE(node);
         _synctex_node_free(__synctex_tree_sibling(node));
-        _synctex_free(node);
+        _synctex_node_dispose(node);
     }
     return;
 }
@@ -1685,17 +2948,18 @@ static SYNCTEX_INLINE synctex_data_p __synctex_data(synctex_node_p node)
     DEFINE_SYNCTEX_DATA_HAS(WHAT);                                                                                                                             \
     static char *_synctex_data_##WHAT(synctex_node_p node)                                                                                                     \
     {                                                                                                                                                          \
+        char *string = NULL;                                                                                                                                   \
         if (_synctex_data_has_##WHAT(node)) {                                                                                                                  \
-            return node->data[node->class_->navigator->size + node->class_->modelator->WHAT].as_string;                                                        \
+            memcpy(&string, __synctex_data(node) + node->class_->modelator->WHAT, sizeof(string));                                                             \
         }                                                                                                                                                      \
-        return NULL;                                                                                                                                           \
+        return string;                                                                                                                                         \
     }                                                                                                                                                          \
     static char *_synctex_data_set_##WHAT(synctex_node_p node, char *new_value)                                                                                \
     {                                                                                                                                                          \
         char *old = "";                                                                                                                                        \
         if (_synctex_data_has_##WHAT(node)) {                                                                                                                  \
-            old = node->data[node->class_->navigator->size + node->class_->modelator->WHAT].as_string;                                                         \
-            node->data[node->class_->navigator->size + node->class_->modelator->WHAT].as_string = new_value;                                                   \
+            memcpy(&old, __synctex_data(node) + node->class_->modelator->WHAT, sizeof(old));                                                                   \
+            memcpy(__synctex_data(node) + node->class_->modelator->WHAT, &new_value, sizeof(new_value));                                                       \
         }                                                                                                                                                      \
         return old;                                                                                                                                            \
     }
@@ -1804,8 +3068,7 @@ static _synctex_class_s _synctex_class_input = {
  *
  */
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_s_input_max + synctex_data_input_tln_max];
 } _synctex_input_s;
 
@@ -1818,7 +3081,7 @@ typedef struct {
 static synctex_node_p _synctex_new_input(synctex_scanner_p scanner)
 {
     if (scanner) {
-        synctex_node_p node = _synctex_malloc(sizeof(_synctex_input_s));
+        synctex_node_p node = _synctex_scanner_new_node(scanner, synctex_node_type_input, sizeof(_synctex_input_s));
         if (node) {
             node->class_ = scanner->class_ + synctex_node_type_input;
             SYNCTEX_DID_NEW(node);
@@ -1842,7 +3105,7 @@ static void _synctex_free_input(synctex_node_p node)
         SYNCTEX_WILL_FREE(node);
         _synctex_node_free(__synctex_tree_sibling(node));
         _synctex_free(_synctex_data_name(node));
-        _synctex_free(node);
+        _synctex_node_dispose(node);
     }
 }
 
@@ -1864,8 +3127,7 @@ static void _synctex_free_input(synctex_node_p node)
 DEFINE_SYNCTEX_DATA_INT_GETSET_DECODE(page);
 
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_scn_sheet_max + synctex_data_p_sheet_max];
 } _synctex_node_sheet_s;
 
@@ -1876,7 +3138,7 @@ typedef struct {
     {                                                                                                                                                          \
         if (scanner) {                                                                                                                                         \
             ++SYNCTEX_CUR;                                                                                                                                     \
-            synctex_node_p node = _synctex_malloc(sizeof(_synctex_node_##NAME##_s));                                                                           \
+            synctex_node_p node = _synctex_scanner_new_node(scanner, synctex_node_type_##NAME, sizeof(_synctex_node_##NAME##_s));                              \
             if (node) {                                                                                                                                        \
                 node->class_ = scanner->class_ + synctex_node_type_##NAME;                                                                                     \
                 SYNCTEX_DID_NEW(node);                                                                                                                         \
@@ -1948,8 +3210,7 @@ static _synctex_class_s _synctex_class_sheet = {
  *  Every node has the same structure, but not the same size.
  */
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_sct_form_max + synctex_data_t_form_max];
 } _synctex_node_form_s;
 
@@ -2022,8 +3283,7 @@ static _synctex_class_s _synctex_class_form = {
  *  Only horizontal boxes are treated differently because of their visible size.
  */
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spcfl_vbox_max + synctex_data_box_max];
 } _synctex_node_vbox_s;
 
@@ -2205,8 +3465,7 @@ static const _synctex_data_model_s synctex_data_model_hbox = {
 };
 
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spcfln_hbox_max + synctex_data_hbox_max];
 } _synctex_node_hbox_s;
 
@@ -2251,8 +3510,7 @@ static const _synctex_tree_model_s synctex_tree_model_spf = {
     synctex_tree_spf_max,
 };
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spf_max + synctex_data_box_max];
 } _synctex_node_void_vbox_s;
 
@@ -2311,8 +3569,7 @@ static _synctex_class_s _synctex_class_void_hbox = {
 
 /*  The form ref node.  */
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spfa_max + synctex_data_ref_thv_max];
 } _synctex_node_ref_s;
 
@@ -2395,8 +3652,7 @@ static const _synctex_data_model_s synctex_data_model_tlchv = {
 };
 
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spf_max + synctex_data_tlchv_max];
 } _synctex_node_tlchv_s;
 
@@ -2468,8 +3724,7 @@ static const _synctex_data_model_s synctex_data_model_tlchvw = {
     synctex_data_tlchvw_max,
 };
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spf_max + synctex_data_tlchvw_max];
 } _synctex_node_kern_s;
 
@@ -2545,8 +3800,7 @@ static _synctex_class_s _synctex_class_glue = {
 #endif
 
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spf_max + synctex_data_box_max];
 } _synctex_node_rule_s;
 
@@ -2615,8 +3869,7 @@ static _synctex_class_s _synctex_class_boundary = {
 #endif
 
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spfa_max + synctex_data_tlchv_max];
 } _synctex_node_box_bdry_s;
 
@@ -2624,7 +3877,7 @@ typedef struct {
     static SYNCTEX_INLINE synctex_node_p _synctex_new_##NAME(synctex_scanner_p scanner)                                                                        \
     {                                                                                                                                                          \
         if (scanner) {                                                                                                                                         \
-            synctex_node_p node = _synctex_malloc(sizeof(_synctex_node_##NAME##_s));                                                                           \
+            synctex_node_p node = _synctex_scanner_new_node(scanner, synctex_node_type_##NAME, sizeof(_synctex_node_##NAME##_s));                              \
             if (node) {                                                                                                                                        \
                 node->class_ = scanner->class_ + synctex_node_type_##NAME;                                                                                     \
                 SYNCTEX_DID_NEW(node);                                                                                                                         \
@@ -2761,8 +4014,7 @@ static const _synctex_data_model_s synctex_data_model_proxy = {
     synctex_data_proxy_hv_max,
 };
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spcflnt_proxy_hbox_max + synctex_data_proxy_hv_max];
 } _synctex_node_proxy_hbox_s;
 
@@ -2843,8 +4095,7 @@ static const _synctex_tree_model_s synctex_tree_model_proxy_vbox = {
 };
 
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spcflt_proxy_vbox_max + synctex_data_proxy_hv_max];
 } _synctex_node_proxy_vbox_s;
 
@@ -2891,8 +4142,7 @@ static const _synctex_tree_model_s synctex_tree_model_proxy = {
 };
 
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spft_proxy_max + synctex_data_proxy_hv_max];
 } _synctex_node_proxy_s;
 
@@ -2947,8 +4197,7 @@ static const _synctex_tree_model_s synctex_tree_model_proxy_last = {
 };
 
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spfat_proxy_last_max + synctex_data_proxy_hv_max];
 } _synctex_node_proxy_last_s;
 
@@ -3021,8 +4270,7 @@ static const _synctex_data_model_s synctex_data_model_handle = {
 };
 
 typedef struct {
-    SYNCTEX_DECLARE_CHARINDEX
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
     _synctex_data_u data[synctex_tree_spct_handle_max + synctex_data_handle_w_max];
 } _synctex_node_handle_s;
 
@@ -3070,22 +4318,168 @@ static SYNCTEX_INLINE synctex_node_p _synctex_new_handle_with_child(synctex_node
     }
     return NULL;
 }
-
-#ifdef SYNCTEX_NOTHING
-#pragma mark -
-#pragma mark Navigation
+/*  The scanner allocating the handles of the results of a query.
+ *  Those of a frozen scanner are allocated in the slabs of a scanner of their own,
+ *  such that concurrent queries do not share any allocator.
+ *  Its first slabs are the ones of the given scanner, where the targets are.
+ *  Otherwise it is a copy of the frozen scanner, which is read only,
+ *  such that the accessors reading the scanner of a result,
+ *  like the visible dimensions or the name, see the unit, the offsets and the inputs.
+ *  It owns none of the memory of the copy.
+ *  - returns: the given scanner when not frozen, NULL on allocation failure.
+ */
+static synctex_scanner_p _synctex_scanner_new_results(synctex_scanner_p scanner)
+{
+    synctex_scanner_p results = NULL;
+    int count = scanner->arena.slab_count;
+    if (!scanner->flags.frozen) {
+        return scanner;
+    }
+    if (NULL == (results = malloc(sizeof(_synctex_scanner_s)))) {
+        return NULL;
+    }
+    *results = *scanner;
+    /*  The parts modified by the queries are its own */
+    results->reader = NULL;
+    results->iterator = NULL;
+#if defined(SYNCTEX_USE_HANDLE)
+    results->handle = NULL;
 #endif
-synctex_node_p synctex_node_parent(synctex_node_p node)
-{
-    return _synctex_tree_parent(node);
+    memset(&results->siblings, 0, sizeof(results->siblings));
+    memset(&results->arena, 0, sizeof(results->arena));
+    if (NULL == (results->arena.slabs = malloc((count + 4) * sizeof(_synctex_slab_s *)))) {
+        free(results);
+        return NULL;
+    }
+    memcpy(results->arena.slabs, scanner->arena.slabs, count * sizeof(_synctex_slab_s *));
+    results->arena.slab_count = results->arena.shared = count;
+    results->arena.slab_capacity = count + 4;
+    /*  small slabs */
+    results->arena.hint = 1;
+    results->class_[synctex_node_type_handle] = scanner->class_[synctex_node_type_handle];
+    results->class_[synctex_node_type_handle].scanner = results;
+    return results;
 }
-synctex_node_p synctex_node_parent_sheet(synctex_node_p node)
+/*  Release all the handles allocated by a scanner for the results of a query at once. */
+static void _synctex_scanner_free_results(synctex_scanner_p scanner, synctex_scanner_p results)
 {
-    while (node && synctex_node_type(node) != synctex_node_type_sheet) {
-        node = _synctex_tree_parent(node);
+    if (results && results != scanner) {
+        _synctex_scanner_free_slabs(results);
+        free(results);
     }
-    /*  exit the while loop either when node is NULL or node is a sheet */
-    return node;
+}
+/*  A handle to the given target allocated by the given results scanner. */
+static SYNCTEX_INLINE synctex_node_p _synctex_new_result(synctex_scanner_p results, synctex_node_p target)
+{
+    if (target) {
+        synctex_node_p result = _synctex_new_handle(results);
+        if (result) {
+            _synctex_tree_set_target(result, target);
+            return result;
+        }
+    }
+    return NULL;
+}
+
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark Specialized accessors
+#endif
+
+/*  When the type of a node is known, so is its layout:
+ *  the data follow the tree links whose number is the size of the tree model,
+ *  and each field is at the index given by the data model.
+ *  The accessors below read the fields at these fixed places,
+ *  without the class indirections nor the has checks of _synctex_data_##WHAT.
+ *  They are meant for the hot query loops that switch on the node type once.
+ *  The numbers below must agree with the tree models and the node structures above,
+ *  the static assertions that follow check the latter.
+ */
+enum {
+    synctex_links_vbox = synctex_tree_spcfl_vbox_max,
+    synctex_links_hbox = synctex_tree_spcfln_hbox_max,
+    synctex_links_void_vbox = synctex_tree_spf_max,
+    synctex_links_void_hbox = synctex_tree_spf_max,
+    synctex_links_kern = synctex_tree_spf_max,
+    synctex_links_glue = synctex_tree_spf_max,
+    synctex_links_rule = synctex_tree_spf_max,
+    synctex_links_math = synctex_tree_spf_max,
+    synctex_links_boundary = synctex_tree_spf_max,
+    synctex_links_box_bdry = synctex_tree_spfa_max,
+    synctex_links_proxy_hbox = synctex_tree_spcflnt_proxy_hbox_max,
+    synctex_links_proxy_vbox = synctex_tree_spcflt_proxy_vbox_max,
+    synctex_links_proxy = synctex_tree_spft_proxy_max,
+    synctex_links_proxy_last = synctex_tree_spfat_proxy_last_max,
+};
+/*  Static assertions that the numbers above agree with the node structures:
+ *  the data of a node of type TYPE are DATA_MAX fields after synctex_links_##TYPE links.
+ *  Otherwise the array size is negative and the compilation fails.
+ */
+#define SYNCTEX_ASSERT_LINKS(TYPE, DATA_MAX) typedef char _synctex_assert_links_##TYPE[sizeof(((_synctex_node_##TYPE##_s *)0)->data) == (synctex_links_##TYPE + (DATA_MAX)) * sizeof(_synctex_data_u) ? 1 : -1]
+SYNCTEX_ASSERT_LINKS(vbox, synctex_data_box_max);
+SYNCTEX_ASSERT_LINKS(hbox, synctex_data_hbox_max);
+SYNCTEX_ASSERT_LINKS(void_vbox, synctex_data_box_max);
+SYNCTEX_ASSERT_LINKS(void_hbox, synctex_data_box_max);
+SYNCTEX_ASSERT_LINKS(kern, synctex_data_tlchvw_max);
+SYNCTEX_ASSERT_LINKS(glue, synctex_data_tlchv_max);
+SYNCTEX_ASSERT_LINKS(rule, synctex_data_box_max);
+SYNCTEX_ASSERT_LINKS(math, synctex_data_tlchv_max);
+SYNCTEX_ASSERT_LINKS(boundary, synctex_data_tlchv_max);
+SYNCTEX_ASSERT_LINKS(box_bdry, synctex_data_tlchv_max);
+SYNCTEX_ASSERT_LINKS(proxy_hbox, synctex_data_proxy_hv_max);
+SYNCTEX_ASSERT_LINKS(proxy_vbox, synctex_data_proxy_hv_max);
+SYNCTEX_ASSERT_LINKS(proxy, synctex_data_proxy_hv_max);
+SYNCTEX_ASSERT_LINKS(proxy_last, synctex_data_proxy_hv_max);
+#undef SYNCTEX_ASSERT_LINKS
+/*  The WHAT field of NODE, a node of type synctex_node_type_##TYPE.
+ *  For proxies, WHAT is proxy_h or proxy_v.
+ */
+#define SYNCTEX_FIXED(NODE, TYPE, WHAT) ((NODE)->data[synctex_links_##TYPE + synctex_data_##WHAT##_idx].as_integer)
+/*  Same as above when the type is only known at run time,
+ *  LINKS is the number of tree links of the node.
+ */
+#define SYNCTEX_FIXED_AT(NODE, LINKS, WHAT) ((NODE)->data[(LINKS) + synctex_data_##WHAT##_idx].as_integer)
+
+/*  The number of tree links of a node with tag, line and geometry,
+ *  -1 for the other nodes, including proxies.
+ */
+static SYNCTEX_INLINE int _synctex_noxy_links(synctex_node_p node)
+{
+    switch (node->class_->type) {
+    case synctex_node_type_vbox:
+        return synctex_links_vbox;
+    case synctex_node_type_hbox:
+        return synctex_links_hbox;
+    case synctex_node_type_void_vbox:
+    case synctex_node_type_void_hbox:
+    case synctex_node_type_kern:
+    case synctex_node_type_glue:
+    case synctex_node_type_rule:
+    case synctex_node_type_math:
+    case synctex_node_type_boundary:
+        return synctex_tree_spf_max;
+    case synctex_node_type_box_bdry:
+        return synctex_links_box_bdry;
+    default:
+        return -1;
+    }
+}
+
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark Navigation
+#endif
+synctex_node_p synctex_node_parent(synctex_node_p node)
+{
+    return _synctex_tree_parent(node);
+}
+synctex_node_p synctex_node_parent_sheet(synctex_node_p node)
+{
+    while (node && synctex_node_type(node) != synctex_node_type_sheet) {
+        node = _synctex_tree_parent(node);
+    }
+    /*  exit the while loop either when node is NULL or node is a sheet */
+    return node;
 }
 synctex_node_p synctex_node_parent_form(synctex_node_p node)
 {
@@ -3279,24 +4673,304 @@ static SYNCTEX_INLINE synctex_node_p synctex_tree_set_friend(synctex_node_p node
 #endif
     return new_friend ? _synctex_tree_set_friend(node, new_friend) : _synctex_tree_reset_friend(node);
 }
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark Directories
+#endif
+
+/*  Keys up to twice the number of stored nodes plus this margin are stored.
+ */
+#define SYNCTEX_DIRECTORY_MARGIN 1024
+
+/*  Grow a column of the directory with zeroed items, nothing to do when it is not allocated.
+ *  - returns: synctex_NO on allocation failure, the column is then unchanged.
+ */
+static synctex_bool_t _synctex_directory_grow_column(void **column, size_t size, int capacity, int new_capacity)
+{
+    char *items = NULL;
+    if (NULL == *column) {
+        return synctex_YES;
+    }
+    if (NULL == (items = realloc(*column, new_capacity * size))) {
+        return synctex_NO;
+    }
+    memset(items + capacity * size, 0, (new_capacity - capacity) * size);
+    *column = items;
+    return synctex_YES;
+}
+/*  Store the node with the given key.
+ *  When the key is already used, the node replaces the old one on demand only.
+ *  - returns: SYNCTEX_STATUS_OK when stored,
+ *      SYNCTEX_STATUS_NOT_OK when the directory becomes sparse.
+ */
+static synctex_status_t _synctex_directory_add(_synctex_directory_s *directory, int key, synctex_node_p node, synctex_bool_t replace)
+{
+    if (key <= 0 || key > 2 * directory->count + SYNCTEX_DIRECTORY_MARGIN) {
+        directory->sparse = synctex_YES;
+        return SYNCTEX_STATUS_NOT_OK;
+    }
+    if (key >= directory->capacity) {
+        int capacity = 2 * directory->capacity > key ? 2 * directory->capacity : key + SYNCTEX_DIRECTORY_MARGIN;
+        synctex_node_p *nodes = NULL;
+        /*  The nodes last, such that no node is stored beyond the other columns */
+        if (!_synctex_directory_grow_column((void **)&directory->entries, sizeof(int), directory->capacity, capacity)
+            || !_synctex_directory_grow_column((void **)&directory->geometries, sizeof(_synctex_geometry_p), directory->capacity, capacity)
+            || NULL == (nodes = realloc(directory->nodes, capacity * sizeof(synctex_node_p)))) {
+            directory->sparse = synctex_YES;
+            return SYNCTEX_STATUS_NOT_OK;
+        }
+        memset(nodes + directory->capacity, 0, (capacity - directory->capacity) * sizeof(synctex_node_p));
+        directory->nodes = nodes;
+        directory->capacity = capacity;
+    }
+    if (NULL == directory->nodes[key]) {
+        ++directory->count;
+    } else if (!replace) {
+        return SYNCTEX_STATUS_OK;
+    }
+    directory->nodes[key] = node;
+    return SYNCTEX_STATUS_OK;
+}
+/*  The node with the given key, NULL if none or not stored.
+ */
+static SYNCTEX_INLINE synctex_node_p _synctex_directory_get(_synctex_directory_s *directory, int key)
+{
+    return key > 0 && key < directory->capacity ? directory->nodes[key] : NULL;
+}
+/*  Record the index of the sheet entry of the node stored with the given key,
+ *  such that lazy parsing finds the content of a page without searching.
+ *  - returns: SYNCTEX_STATUS_NOT_OK when the node is not stored with that key,
+ *      SYNCTEX_STATUS_ERROR on allocation failure.
+ */
+static synctex_status_t _synctex_directory_set_entry(_synctex_directory_s *directory, int key, synctex_node_p node, int entry)
+{
+    if (node != _synctex_directory_get(directory, key)) {
+        return SYNCTEX_STATUS_NOT_OK;
+    }
+    if (NULL == directory->entries && NULL == (directory->entries = _synctex_malloc(directory->capacity * sizeof(int)))) {
+        return SYNCTEX_STATUS_ERROR;
+    }
+    directory->entries[key] = entry + 1;
+    return SYNCTEX_STATUS_OK;
+}
+/*  The index of the sheet entry of the node with the given key,
+ *  -1 if none, -2 if not known.
+ */
+static SYNCTEX_INLINE int _synctex_directory_get_entry(_synctex_directory_s *directory, int key)
+{
+    if (NULL == directory->entries || key <= 0 || key >= directory->capacity) {
+        return -2;
+    }
+    return directory->entries[key] - 1;
+}
+/*  Record the geometry store of the sheet stored with the given key.
+ *  - returns: SYNCTEX_STATUS_NOT_OK when the sheet is not stored with that key,
+ *      SYNCTEX_STATUS_ERROR on allocation failure.
+ */
+static synctex_status_t _synctex_directory_set_geometry(_synctex_directory_s *directory, int key, synctex_node_p sheet, _synctex_geometry_p geometry)
+{
+    if (sheet != _synctex_directory_get(directory, key)) {
+        return SYNCTEX_STATUS_NOT_OK;
+    }
+    if (NULL == directory->geometries && NULL == (directory->geometries = _synctex_malloc(directory->capacity * sizeof(_synctex_geometry_p)))) {
+        return SYNCTEX_STATUS_ERROR;
+    }
+    directory->geometries[key] = geometry;
+    return SYNCTEX_STATUS_OK;
+}
+/*  Whether the geometry store of the sheet with the given key is known.
+ *  On return, *geometry is that store, NULL if not yet built.
+ */
+static SYNCTEX_INLINE synctex_bool_t _synctex_directory_get_geometry(_synctex_directory_s *directory, int key, synctex_node_p sheet, _synctex_geometry_p *geometry)
+{
+    if (NULL == directory->geometries || sheet != _synctex_directory_get(directory, key)) {
+        return synctex_NO;
+    }
+    *geometry = directory->geometries[key];
+    return synctex_YES;
+}
+
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark Friend index
+#endif
+
+#define SYNCTEX_FRIENDS_MIN_CAPACITY 1024
+
+static SYNCTEX_INLINE unsigned int _synctex_friend_hash(int tag, int line)
+{
+    unsigned int h = (unsigned int)tag * 0x9E3779B1u + (unsigned int)line;
+    h ^= h >> 15;
+    h *= 0x85EBCA6Bu;
+    return h ^ (h >> 13);
+}
+/*  The entry of the given tag and line,
+ *  or the empty entry where it should be inserted.
+ *  The table must not be full.
+ */
+static SYNCTEX_INLINE _synctex_friend_s *_synctex_scanner_friend_entry(synctex_scanner_p scanner, int tag, int line)
+{
+    unsigned int mask = (unsigned int)scanner->friends.capacity - 1;
+    unsigned int i = _synctex_friend_hash(tag, line) & mask;
+    _synctex_friend_s *entry = scanner->friends.entries + i;
+    while (entry->node && (entry->tag != tag || entry->line != line)) {
+        i = (i + 1) & mask;
+        entry = scanner->friends.entries + i;
+    }
+    return entry;
+}
+/*  Double the capacity of the friend index.
+ *  - returns: SYNCTEX_STATUS_ERROR on allocation failure,
+ *      the index is then unchanged.
+ */
+static synctex_status_t _synctex_scanner_grow_friends(synctex_scanner_p scanner)
+{
+    _synctex_friend_s *old = scanner->friends.entries;
+    int old_capacity = scanner->friends.capacity;
+    int capacity = old_capacity ? 2 * old_capacity : SYNCTEX_FRIENDS_MIN_CAPACITY;
+    _synctex_friend_s *entries = (_synctex_friend_s *)_synctex_malloc(capacity * sizeof(_synctex_friend_s));
+    int i;
+    if (NULL == entries) {
+        return SYNCTEX_STATUS_ERROR;
+    }
+    scanner->friends.entries = entries;
+    scanner->friends.capacity = capacity;
+    for (i = 0; i < old_capacity; ++i) {
+        if (old[i].node) {
+            *_synctex_scanner_friend_entry(scanner, old[i].tag, old[i].line) = old[i];
+        }
+    }
+    free(old);
+    return SYNCTEX_STATUS_OK;
+}
+/*  The first node with the given tag and line, NULL if none.
+ *  The other ones follow through the friend field.
+ */
+static SYNCTEX_INLINE synctex_node_p _synctex_scanner_friend(synctex_scanner_p scanner, int tag, int line)
+{
+    return scanner->friends.count ? _synctex_scanner_friend_entry(scanner, tag, line)->node : NULL;
+}
+static int _synctex_friend_cmp(const void *a, const void *b)
+{
+    const _synctex_friend_s *l = a;
+    const _synctex_friend_s *r = b;
+    if (l->tag != r->tag) {
+        return l->tag < r->tag ? -1 : 1;
+    }
+    return l->line < r->line ? -1 : l->line > r->line;
+}
+/*  The keys with the given tag and a line between first and last
+ *  among the given keys sorted by tag then line.
+ *  - returns: the first key, the number of keys in *count,
+ *      NULL when there is none.
+ */
+static _synctex_friend_s *_synctex_keys_range(_synctex_friend_s *entries, int n, int tag, int first, int last, int *count)
+{
+    int low = 0, high = n, end;
+    /*  the first key not before tag and first */
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (entries[middle].tag < tag || (entries[middle].tag == tag && entries[middle].line < first)) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    for (end = low; end < n && entries[end].tag == tag && entries[end].line <= last; ++end) {
+    }
+    *count = end - low;
+    return end > low ? entries + low : NULL;
+}
+/*  Sort the keys of the friend index by tag then line.
+ *  Done once all the sheets are parsed, and again when friends were added since.
+ *  - returns: yorn, no on allocation failure.
+ */
+static synctex_bool_t _synctex_scanner_index_lines(synctex_scanner_p scanner)
+{
+    _synctex_friend_s *entries = NULL;
+    int i, n = 0;
+    free(scanner->lines.entries);
+    scanner->lines.entries = NULL;
+    scanner->lines.count = 0;
+    if (NULL == (entries = _synctex_malloc((scanner->friends.count + 1) * sizeof(_synctex_friend_s)))) {
+        return synctex_NO;
+    }
+    for (i = 0; i < scanner->friends.capacity; ++i) {
+        if (scanner->friends.entries[i].node) {
+            entries[n++] = scanner->friends.entries[i];
+        }
+    }
+    qsort(entries, n, sizeof(_synctex_friend_s), &_synctex_friend_cmp);
+    scanner->lines.entries = entries;
+    scanner->lines.count = n;
+    return synctex_YES;
+}
+/*  The keys of the friend index with the given tag and a line between first and last,
+ *  by increasing line.
+ *  The sorted keys are built again when friends were added since last time.
+ *  - returns: the first key, the number of keys in *count,
+ *      NULL when there is none or on allocation failure.
+ */
+static _synctex_friend_s *_synctex_scanner_lines(synctex_scanner_p scanner, int tag, int first, int last, int *count)
+{
+    *count = 0;
+    if ((scanner->lines.count != scanner->friends.count || NULL == scanner->lines.entries) && !_synctex_scanner_index_lines(scanner)) {
+        return NULL;
+    }
+    return _synctex_keys_range(scanner->lines.entries, scanner->lines.count, tag, first, last, count);
+}
+/*  Record the node, its tag and line, such that it is registered afterwards
+ *  as if it were registered now, see _synctex_scanner_parse_sheets_in_parallel.
+ */
+static void _synctex_scanner_defer_friend(synctex_scanner_p scanner, synctex_node_p node, int tag, int line)
+{
+    if (scanner->deferred.count == scanner->deferred.capacity) {
+        int capacity = scanner->deferred.capacity ? 2 * scanner->deferred.capacity : 1024;
+        _synctex_friend_s *entries = realloc(scanner->deferred.entries, capacity * sizeof(_synctex_friend_s));
+        if (NULL == entries) {
+            _synctex_error("!  _synctex_scanner_defer_friend: Memory problem");
+            return;
+        }
+        scanner->deferred.entries = entries;
+        scanner->deferred.capacity = capacity;
+    }
+    scanner->deferred.entries[scanner->deferred.count++] = (_synctex_friend_s){tag, line, node};
+}
 /**
- *
+ *  Register the node as the first friend with the given tag and line.
+ *  - returns: the old friend of the node.
  */
-static SYNCTEX_INLINE synctex_node_p __synctex_node_make_friend(synctex_node_p node, int i)
+static SYNCTEX_INLINE synctex_node_p __synctex_node_make_friend(synctex_node_p node, int tag, int line)
 {
+    synctex_scanner_p scanner = node->class_->scanner;
     synctex_node_p old = NULL;
-    if (i >= 0) {
-        i = i % (node->class_->scanner->number_of_lists);
-        old = synctex_tree_set_friend(node, (node->class_->scanner->lists_of_friends)[i]);
-        (node->class_->scanner->lists_of_friends)[i] = node;
+    _synctex_friend_s *entry;
+    if (scanner->flags.deferred) {
+        _synctex_scanner_defer_friend(scanner, node, tag, line);
+        return __synctex_tree_reset_friend(node);
+    }
+    /*  keep the load factor below 1/2,
+     *  when memory is low, keep at least one empty entry */
+    if (2 * (scanner->friends.count + 1) > scanner->friends.capacity && _synctex_scanner_grow_friends(scanner) < SYNCTEX_STATUS_OK
+        && scanner->friends.count + 1 >= scanner->friends.capacity) {
+        _synctex_error("!  __synctex_node_make_friend: Memory problem");
+        return __synctex_tree_reset_friend(node);
+    }
+    entry = _synctex_scanner_friend_entry(scanner, tag, line);
+    if (NULL == entry->node) {
+        entry->tag = tag;
+        entry->line = line;
+        ++scanner->friends.count;
+    }
+    old = synctex_tree_set_friend(node, entry->node);
+    entry->node = node;
 #if SYNCTEX_DEBUG > 500
-        printf("tl(%i)=>", i);
-        synctex_node_log(node);
-        if (synctex_node_parent_form(node)) {
-            printf("!  ERROR. No registration expected!\n");
-        }
-#endif
+    printf("tl(%i,%i)=>", tag, line);
+    synctex_node_log(node);
+    if (synctex_node_parent_form(node)) {
+        printf("!  ERROR. No registration expected!\n");
     }
+#endif
     return old;
 }
 /**
@@ -3309,8 +4983,7 @@ static SYNCTEX_INLINE synctex_node_p __synctex_proxy_make_friend_and_next_hbox(s
     synctex_node_p old = NULL;
     synctex_node_p target = _synctex_tree_target(node);
     if (target) {
-        int i = _synctex_data_tag(target) + _synctex_data_line(target);
-        old = __synctex_node_make_friend(node, i);
+        old = __synctex_node_make_friend(node, _synctex_data_tag(target), _synctex_data_line(target));
     } else {
         old = __synctex_tree_reset_friend(node);
     }
@@ -3329,8 +5002,7 @@ static SYNCTEX_INLINE synctex_node_p __synctex_proxy_make_friend_and_next_hbox(s
  */
 static SYNCTEX_INLINE synctex_node_p __synctex_node_make_friend_tlc(synctex_node_p node)
 {
-    int i = synctex_node_tag(node) + synctex_node_line(node);
-    return __synctex_node_make_friend(node, i);
+    return __synctex_node_make_friend(node, synctex_node_tag(node), synctex_node_line(node));
 }
 /**
  *  Register a node which have tag, line and column.
@@ -3344,6 +5016,84 @@ static SYNCTEX_INLINE void _synctex_node_make_friend_tlc(synctex_node_p node)
         __synctex_node_make_friend_tlc(node);
     }
 }
+/**
+ *  Record in each child of the given node the number of its friends
+ *  among its siblings, itself included, to rank display query results.
+ *  Called once the tag and line of the children are known.
+ *  On allocation failure, the children are left with 0 friends,
+ *  they are counted at query time.
+ */
+static void _synctex_node_count_friends(synctex_node_p parent)
+{
+    synctex_scanner_p scanner = parent->class_->scanner;
+    synctex_node_p N = _synctex_tree_child(parent);
+    _synctex_sibling_s *children = scanner->siblings.children;
+    _synctex_tally_s *entry = NULL;
+    unsigned int i = 0;
+    unsigned int mask;
+    unsigned int stamp;
+    int count = 0;
+    int capacity = 16;
+    int j;
+    for (; N; N = __synctex_tree_sibling(N)) {
+        if (count == scanner->siblings.count) {
+            int more = count ? 2 * count : 64;
+            if (NULL == (children = realloc(scanner->siblings.children, more * sizeof(_synctex_sibling_s)))) {
+                return;
+            }
+            scanner->siblings.children = children;
+            scanner->siblings.count = more;
+        }
+        children[count++].node = N;
+    }
+    if (count < 2) {
+        if (count) {
+            children[0].node->friends = 1;
+        }
+        return;
+    }
+    while (capacity < 2 * count) {
+        capacity *= 2;
+    }
+    if (capacity > scanner->siblings.capacity) {
+        _synctex_tally_s *entries = realloc(scanner->siblings.entries, capacity * sizeof(_synctex_tally_s));
+        if (NULL == entries) {
+            return;
+        }
+        memset(entries + scanner->siblings.capacity, 0, (capacity - scanner->siblings.capacity) * sizeof(_synctex_tally_s));
+        scanner->siblings.entries = entries;
+        scanner->siblings.capacity = capacity;
+    }
+    if (0 == (stamp = ++scanner->siblings.stamp)) {
+        memset(scanner->siblings.entries, 0, scanner->siblings.capacity * sizeof(_synctex_tally_s));
+        stamp = ++scanner->siblings.stamp;
+    }
+    mask = (unsigned int)capacity - 1;
+    /*  Record the entry of each child, then read the count.
+     *  Consecutive children often have the same tag and line. */
+    for (j = 0; j < count; ++j) {
+        int tag = synctex_node_tag(children[j].node);
+        int line = synctex_node_line(children[j].node);
+        if (NULL == entry || entry->tag != tag || entry->line != line) {
+            i = _synctex_friend_hash(tag, line) & mask;
+            entry = scanner->siblings.entries + i;
+            while (entry->stamp == stamp && (entry->tag != tag || entry->line != line)) {
+                i = (i + 1) & mask;
+                entry = scanner->siblings.entries + i;
+            }
+            if (entry->stamp != stamp) {
+                *entry = (_synctex_tally_s){tag, line, 0, stamp};
+            }
+        }
+        ++entry->count;
+        children[j].slot = i;
+    }
+    for (j = 0; j < count; ++j) {
+        int friends = scanner->siblings.entries[children[j].slot].count;
+        /*  Larger numbers are counted by the display queries */
+        children[j].node->friends = friends <= SYNCTEX_NODE_FRIENDS_MAX ? friends : 0;
+    }
+}
 static synctex_node_p _synctex_node_set_child(synctex_node_p node, synctex_node_p new_child);
 /**
  *  The (first) child of the node, if any, NULL otherwise.
@@ -3394,11 +5144,13 @@ static synctex_node_p _synctex_node_set_child(synctex_node_p parent, synctex_nod
         if ((child = old)) {
             do {
                 _synctex_tree_reset_parent(child);
+                child->page = 0;
             } while ((child = __synctex_tree_sibling(child)));
         }
         if ((child = new_child)) {
             do {
                 _synctex_tree_set_parent(child, parent);
+                child->page = parent->page;
                 last_child = child;
             } while ((child = __synctex_tree_sibling(child)));
         }
@@ -3462,6 +5214,7 @@ static synctex_node_p _synctex_node_set_sibling(synctex_node_p node, synctex_nod
                 while (synctex_YES) {
                     if (_synctex_tree_has_parent(N)) {
                         __synctex_tree_set_parent(N, parent);
+                        N->page = parent->page;
                         _synctex_tree_set_last(parent, N);
                         N = __synctex_tree_sibling(N);
                         continue;
@@ -4488,8 +6241,6 @@ int _synctex_scanner_pre_y_offset(synctex_scanner_p scanner);
 #pragma mark SCANNER UTILITIES
 #endif
 
-#define SYNCTEX_FILE (scanner->reader->file)
-
 /**
  *  Try to ensure that the buffer contains at least size bytes.
  *  Passing a huge size argument means the whole buffer length.
@@ -4499,6 +6250,11 @@ int _synctex_scanner_pre_y_offset(synctex_scanner_p scanner);
  *  It is the responsibility of the caller to test whether this size is conforming to its needs.
  *  Negative values may return in case of error, actually
  *  when there was an error reading the synctex file.
+ *  When the synctex file is memory mapped, the reader is not open:
+ *  the whole file is already available and the buffer is never refilled.
+ *  The unparsed characters are retained when the buffer is refilled,
+ *  and the file is read until at least expected characters are available, unless it ends:
+ *  this is the lookahead _synctex_match_string relies on.
  *  - parameter scanner: The owning scanner. When NULL, returns SYNCTEX_STATUS_BAD_ARGUMENT.
  *  - parameter expected: expected number of bytes.
  *  - returns: a size and a status.
@@ -4517,7 +6273,7 @@ static _synctex_zs_s _synctex_buffer_get_available_size(synctex_scanner_p scanne
         /*  There are already sufficiently many characters in the buffer */
         return (_synctex_zs_s){size, SYNCTEX_STATUS_OK};
     }
-    if (SYNCTEX_FILE) {
+    if (_synctex_reader_is_open(scanner->reader)) {
         /*  Copy the remaining part of the buffer to the beginning,
          *  then read the next part of the file */
         int already_read = 0;
@@ -4527,16 +6283,20 @@ static _synctex_zs_s _synctex_buffer_get_available_size(synctex_scanner_p scanne
         if (size) {
             memmove(SYNCTEX_START, SYNCTEX_CUR, size);
         }
-        SYNCTEX_CUR = SYNCTEX_START + size; /*  the next character after the move, will change. */
-        /*  Fill the buffer up to its end */
-        already_read = gzread(SYNCTEX_FILE, (void *)SYNCTEX_CUR, (int)(SYNCTEX_BUFFER_SIZE - size));
-        if (already_read > 0) {
-            /*  We assume that 0<already_read<=SYNCTEX_BUFFER_SIZE - size, such that
-             *  SYNCTEX_CUR + already_read = SYNCTEX_START + size  + already_read <= SYNCTEX_START + SYNCTEX_BUFFER_SIZE */
-            SYNCTEX_END = SYNCTEX_CUR + already_read;
+        SYNCTEX_CUR = SYNCTEX_END = SYNCTEX_START + size; /*  the next character after the move, will change. */
+        /*  Fill the buffer up to its end, reads may return less than asked. */
+        while ((already_read = _synctex_reader_read(scanner->reader, (void *)SYNCTEX_END, (unsigned)(SYNCTEX_START + SYNCTEX_BUFFER_SIZE - SYNCTEX_END))) > 0) {
+            /*  We assume that 0<already_read<=SYNCTEX_START + SYNCTEX_BUFFER_SIZE - SYNCTEX_END, such that
+             *  SYNCTEX_END + already_read <= SYNCTEX_START + SYNCTEX_BUFFER_SIZE */
+            SYNCTEX_END += already_read;
+            if ((size_t)(SYNCTEX_END - SYNCTEX_START) >= expected) {
+                break;
+            }
+        }
+        if (SYNCTEX_END > SYNCTEX_CUR) {
             /*  If the end of the file was reached, all the required SYNCTEX_BUFFER_SIZE - available
              *  may not be filled with values from the file.
-             *  In that case, the buffer should stop properly after already_read characters. */
+             *  In that case, the buffer should stop properly after the last character read. */
             *SYNCTEX_END = '\0'; /* there is enough room */
             SYNCTEX_CUR = SYNCTEX_START;
             /*  May be available is less than size, the caller will have to test. */
@@ -4544,7 +6304,7 @@ static _synctex_zs_s _synctex_buffer_get_available_size(synctex_scanner_p scanne
         } else if (0 > already_read) {
             /*  There is a possible error in reading the file */
             int errnum = 0;
-            const char *error_string = gzerror(SYNCTEX_FILE, &errnum);
+            const char *error_string = _synctex_reader_error(scanner->reader, &errnum);
             if (Z_ERRNO == errnum) {
                 /*  There is an error in zlib caused by the file system */
                 _synctex_error("gzread error from the file system (%i)", errno);
@@ -4554,9 +6314,11 @@ static _synctex_zs_s _synctex_buffer_get_available_size(synctex_scanner_p scanne
                 return (_synctex_zs_s){0, SYNCTEX_STATUS_ERROR};
             }
         }
-        /*  Nothing was read, we are at the end of the file. */
-        gzclose(SYNCTEX_FILE);
-        SYNCTEX_FILE = NULL;
+        /*  Nothing was read, we are at the end of the file.
+         *  When parsing lazily, the file is still needed to parse the sheets. */
+        if (!scanner->flags.lazy) {
+            _synctex_reader_close(scanner->reader);
+        }
         SYNCTEX_END = SYNCTEX_CUR;
         SYNCTEX_CUR = SYNCTEX_START;
         *SYNCTEX_END = '\0'; /*  Terminate the string properly.*/
@@ -4567,6 +6329,16 @@ static _synctex_zs_s _synctex_buffer_get_available_size(synctex_scanner_p scanne
     return (_synctex_zs_s){size, SYNCTEX_STATUS_EOF};
 }
 
+/*  The first '\n' character in [ptr, end), end if there is none.
+ *  Lines are short, but most of the parsing time is spent looking for their ends:
+ *  memchr is vectorized by the C library on the usual platforms,
+ *  with a word at a time fallback elsewhere.
+ */
+static SYNCTEX_INLINE char *_synctex_find_eol(char *ptr, char *end)
+{
+    char *eol = memchr(ptr, '\n', end - ptr);
+    return eol ? eol : end;
+}
 /*  Used when parsing the synctex file.
  *  Advance to the next character starting a line.
  *  Actually, only '\n' is recognized as end of line marker.
@@ -4583,13 +6355,14 @@ static synctex_status_t _synctex_next_line(synctex_scanner_p scanner)
         return SYNCTEX_STATUS_BAD_ARGUMENT;
     }
 infinite_loop:
-    while (SYNCTEX_CUR < SYNCTEX_END) {
-        if (*SYNCTEX_CUR == '\n') {
-            ++SYNCTEX_CUR;
+    if (SYNCTEX_CUR < SYNCTEX_END) {
+        char *eol = _synctex_find_eol(SYNCTEX_CUR, SYNCTEX_END);
+        if (eol < SYNCTEX_END) {
+            SYNCTEX_CUR = eol + 1;
             ++scanner->reader->line_number;
             return _synctex_buffer_get_available_size(scanner, 1).status;
         }
-        ++SYNCTEX_CUR;
+        SYNCTEX_CUR = SYNCTEX_END;
     }
     /*  Here, we have SYNCTEX_CUR == SYNCTEX_END, such that the next call to _synctex_buffer_get_available_size
      *  will read another bunch of synctex file. Little by little, we advance to the end of the file. */
@@ -4606,114 +6379,36 @@ infinite_loop:
  *  SYNCTEX_STATUS_EOF is returned when the EOF is reached,
  *  SYNCTEX_STATUS_NOT_OK is returned is the string is not found,
  *  an error status is returned otherwise.
- *  This is a critical method because buffering renders things more difficult.
- *  The given string might be as long as the maximum size_t value.
- *  As side effect, the buffer state may have changed if the given argument string can't fit into the buffer.
+ *  The given string must fit into the buffer: once the buffer is asked for that many characters,
+ *  either they are all available or the file ends before, see _synctex_buffer_get_available_size.
+ *  Nothing is consumed unless the string is found, such that a failed match never seeks back the file.
  */
 static synctex_status_t _synctex_match_string(synctex_scanner_p scanner, const char *the_string)
 {
-    /* size_t tested_len = 0; */ /*  the number of characters at the beginning of the_string that match */
-    size_t remaining_len = 0; /*  the number of remaining characters of the_string that should match */
-    size_t available = 0;
+    size_t len = 0; /*  the number of characters of the_string that should match */
     _synctex_zs_s zs = {0, 0};
     if (NULL == scanner || NULL == the_string) {
         return SYNCTEX_STATUS_BAD_ARGUMENT;
     }
-    remaining_len = strlen(the_string); /*  All the_string should match */
-    if (0 == remaining_len) {
+    len = strlen(the_string); /*  All the_string should match */
+    if (0 == len || (!scanner->reader->mapped && len > SYNCTEX_BUFFER_SIZE)) {
         return SYNCTEX_STATUS_BAD_ARGUMENT;
     }
     /*  How many characters available in the buffer? */
-    zs = _synctex_buffer_get_available_size(scanner, remaining_len);
+    zs = _synctex_buffer_get_available_size(scanner, len);
     if (zs.status < SYNCTEX_STATUS_EOF) {
         return zs.status;
     }
-    /*  Maybe we have less characters than expected because the buffer is too small. */
-    if (zs.size >= remaining_len) {
-        /*  The buffer is sufficiently big to hold the expected number of characters. */
-        if (strncmp((char *)SYNCTEX_CUR, the_string, remaining_len)) {
-            return SYNCTEX_STATUS_NOT_OK;
-        }
-    return_OK:
-        /*  Advance SYNCTEX_CUR to the next character after the_string. */
-        SYNCTEX_CUR += remaining_len;
-        return SYNCTEX_STATUS_OK;
-    } else if (strncmp((char *)SYNCTEX_CUR, the_string, zs.size)) {
-        /*  No need to go further, this is not the expected string in the buffer. */
+    if (zs.size < len) {
+        /*  The file ends before the end of the string. */
+        return strncmp((char *)SYNCTEX_CUR, the_string, zs.size) ? SYNCTEX_STATUS_NOT_OK : SYNCTEX_STATUS_EOF;
+    }
+    if (strncmp((char *)SYNCTEX_CUR, the_string, len)) {
         return SYNCTEX_STATUS_NOT_OK;
-    } else if (SYNCTEX_FILE) {
-        /*  The buffer was too small to contain remaining_len characters.
-         *  We have to cut the string into pieces. */
-        z_off_t offset = 0L;
-        /*  the first part of the string is found, advance the_string to the next untested character. */
-        the_string += zs.size;
-        /*  update the remaining length and the parsed length. */
-        remaining_len -= zs.size;
-        /* tested_len += zs.size; */
-        SYNCTEX_CUR += zs.size; /*  We validate the tested characters. */
-        if (0 == remaining_len) {
-            /*  Nothing left to test, we have found the given string. */
-            return SYNCTEX_STATUS_OK;
-        }
-        /*  We also have to record the current state of the file cursor because
-         *  if the_string does not match, all this should be a totally blank operation,
-         *  for which the file and buffer states should not be modified at all.
-         *  In fact, the states of the buffer before and after this function are in general different
-         *  but they are totally equivalent as long as the values of the buffer before SYNCTEX_CUR
-         *  can be safely discarded.  */
-        offset = gztell(SYNCTEX_FILE);
-        /*  offset now corresponds to the first character of the file that was not buffered. */
-        /*  SYNCTEX_CUR - SYNCTEX_START is the number of chars that where already buffered and
-         *  that match the head of the_string. If in fine the_string does not match, all these chars must be recovered
-         *  because the whole buffer contents is replaced in _synctex_buffer_get_available_size.
-         *  They were buffered from offset-len location in the file. */
-        offset -= SYNCTEX_CUR - SYNCTEX_START;
-    more_characters:
-        /*  There is still some work to be done, so read another bunch of file.
-         *  This is the second call to _synctex_buffer_get_available_size,
-         *  which means that the actual contents of the buffer will be discarded.
-         *  We will definitely have to recover the previous state in case we do not find the expected string. */
-        zs = _synctex_buffer_get_available_size(scanner, remaining_len);
-        if (zs.status < SYNCTEX_STATUS_EOF) {
-            return zs.status; /*  This is an error, no need to go further. */
-        }
-        if (zs.size == 0) {
-            /*  Missing characters: recover the initial state of the file and return. */
-        return_NOT_OK:
-            if (offset != gzseek(SYNCTEX_FILE, offset, SEEK_SET)) {
-                /*  This is a critical error, we could not recover the previous state. */
-                _synctex_error("Can't seek file");
-                return SYNCTEX_STATUS_ERROR;
-            }
-            /*  Next time we are asked to fill the buffer,
-             *  we will read a complete bunch of text from the file. */
-            SYNCTEX_CUR = SYNCTEX_END;
-            return SYNCTEX_STATUS_NOT_OK;
-        }
-        if (zs.size < remaining_len) {
-            /*  We'll have to loop one more time. */
-            if (strncmp((char *)SYNCTEX_CUR, the_string, zs.size)) {
-                /*  This is not the expected string, recover the previous state and return. */
-                goto return_NOT_OK;
-            }
-            /*  Advance the_string to the first untested character. */
-            the_string += available;
-            /*  update the remaining length and the parsed length. */
-            remaining_len -= zs.size;
-            /* tested_len += zs.size; */
-            SYNCTEX_CUR += zs.size; /*  We validate the tested characters. */
-            goto more_characters;
-        }
-        /*  This is the last step. */
-        if (strncmp((char *)SYNCTEX_CUR, the_string, remaining_len)) {
-            /*  This is not the expected string, recover the previous state and return. */
-            goto return_NOT_OK;
-        }
-        goto return_OK;
-    } else {
-        /*  The buffer can't contain the given string argument, and the EOF was reached */
-        return SYNCTEX_STATUS_EOF;
     }
+    /*  Advance SYNCTEX_CUR to the next character after the_string. */
+    SYNCTEX_CUR += len;
+    return SYNCTEX_STATUS_OK;
 }
 
 /*  Used when parsing the synctex file.
@@ -4751,7 +6446,7 @@ static _synctex_is_s _synctex_decode_int(synctex_scanner_p scanner)
             return (_synctex_is_s){0, SYNCTEX_STATUS_NOT_OK};
         }
     }
-    result = synctex_parse_int(ptr, &end);
+    result = (*scanner->parse_int)(ptr, &end);
     if (end > ptr) {
         SYNCTEX_CUR = end;
         return (_synctex_is_s){result, SYNCTEX_STATUS_OK};
@@ -4782,7 +6477,7 @@ static _synctex_is_s _synctex_decode_int_opt(synctex_scanner_p scanner, int defa
         if (zs.size == 0) {
             return (_synctex_is_s){default_value, SYNCTEX_STATUS_NOT_OK};
         }
-        result = synctex_parse_int(ptr, &end);
+        result = (*scanner->parse_int)(ptr, &end);
         if (end > ptr) {
             SYNCTEX_CUR = end;
             return (_synctex_is_s){result, SYNCTEX_STATUS_OK};
@@ -4859,9 +6554,7 @@ static _synctex_ss_s _synctex_decode_string(synctex_scanner_p scanner)
     /*  end will point to the next unparsed '\n' character in the file, when mapped to the buffer. */
     end = SYNCTEX_CUR;
     /*  We scan all the characters up to the next '\n' */
-    while (end < SYNCTEX_END && *end != '\n') {
-        ++end;
-    }
+    end = _synctex_find_eol(end, SYNCTEX_END);
     /*  OK, we found where to stop:
      *      either end == SYNCTEX_END
      *      or *end == '\n' */
@@ -4946,6 +6639,7 @@ static _synctex_ns_s __synctex_parse_new_input(synctex_scanner_p scanner)
     /*  Prepend this input node to the input linked list of the scanner */
     __synctex_tree_set_sibling(input, scanner->input); /* input has no parent */
     scanner->input = input;
+    _synctex_directory_add(&scanner->input_by_tag, _synctex_data_tag(input), input, synctex_YES);
 #if SYNCTEX_VERBOSE
     synctex_node_log(input);
 #endif
@@ -5072,9 +6766,6 @@ static _synctex_fs_s _synctex_scan_float_and_dimension(synctex_scanner_p scanner
     _synctex_fs_s fs = {0, 0};
     _synctex_zs_s zs = {0, 0};
     char *endptr = NULL;
-#ifdef HAVE_SETLOCALE
-    char *loc = setlocale(LC_NUMERIC, NULL);
-#endif
     if (NULL == scanner) {
         return (_synctex_fs_s){0, SYNCTEX_STATUS_BAD_ARGUMENT};
     }
@@ -5083,13 +6774,7 @@ static _synctex_fs_s _synctex_scan_float_and_dimension(synctex_scanner_p scanner
         _synctex_error("Problem with float.");
         return (_synctex_fs_s){0, zs.status};
     }
-#ifdef HAVE_SETLOCALE
-    setlocale(LC_NUMERIC, "C");
-#endif
-    fs.value = strtod(SYNCTEX_CUR, &endptr);
-#ifdef HAVE_SETLOCALE
-    setlocale(LC_NUMERIC, loc);
-#endif
+    fs.value = synctex_parse_float(SYNCTEX_CUR, &endptr);
     if (endptr == SYNCTEX_CUR) {
         _synctex_error("A float was expected.");
         return (_synctex_fs_s){0, SYNCTEX_STATUS_ERROR};
@@ -5153,9 +6838,6 @@ static synctex_status_t _synctex_scan_post_scriptum(synctex_scanner_p scanner)
     synctex_status_t status = 0;
     _synctex_fs_s fs = {0, 0};
     char *endptr = NULL;
-#ifdef HAVE_SETLOCALE
-    char *loc = setlocale(LC_NUMERIC, NULL);
-#endif
     if (NULL == scanner) {
         return SYNCTEX_STATUS_BAD_ARGUMENT;
     }
@@ -5185,13 +6867,7 @@ next_line:
     /*  Scanning the information */
     status = _synctex_match_string(scanner, "Magnification:");
     if (status == SYNCTEX_STATUS_OK) {
-#ifdef HAVE_SETLOCALE
-        setlocale(LC_NUMERIC, "C");
-#endif
-        scanner->unit = strtod(SYNCTEX_CUR, &endptr);
-#ifdef HAVE_SETLOCALE
-        setlocale(LC_NUMERIC, loc);
-#endif
+        scanner->unit = synctex_parse_float(SYNCTEX_CUR, &endptr);
         if (endptr == SYNCTEX_CUR) {
             _synctex_error("bad magnification in the post scriptum, a float was expected.");
             return SYNCTEX_STATUS_ERROR;
@@ -5394,18 +7070,17 @@ static _synctex_ns_s _synctex_parse_new_sheet(synctex_scanner_p scanner)
         } else if (_synctex_next_line(scanner) < SYNCTEX_STATUS_OK) {
             _synctex_error("Missing end of sheet.");
         } else {
+            /*  Larger pages are found by climbing the tree */
+            node->page = _synctex_data_page(node) > 0 && _synctex_data_page(node) <= SYNCTEX_NODE_PAGE_MAX ? _synctex_data_page(node) : 0;
             /* Now set the owner */
             if (scanner->sheet) {
-                synctex_node_p last_sheet = scanner->sheet;
-                synctex_node_p next_sheet = NULL;
-                while ((next_sheet = __synctex_tree_sibling(last_sheet))) {
-                    last_sheet = next_sheet;
-                }
                 /* sheets have no parent */
-                __synctex_tree_set_sibling(last_sheet, node);
+                __synctex_tree_set_sibling(scanner->sheet_by_page.last, node);
             } else {
                 scanner->sheet = node;
             }
+            scanner->sheet_by_page.last = node;
+            _synctex_directory_add(&scanner->sheet_by_page, _synctex_data_page(node), node, synctex_NO);
             return (_synctex_ns_s){node, SYNCTEX_STATUS_OK};
         }
         _synctex_free_node(node);
@@ -5427,17 +7102,15 @@ static _synctex_ns_s _synctex_parse_new_form(synctex_scanner_p scanner)
         } else {
             printf("FORM TAG: %i\n", synctex_node_tag(node));
             printf("FORM TAG: %i\n", _synctex_data_tag(node));
+            node->page = -1;
             /* Now set the owner */
             if (scanner->form) {
-                synctex_node_p last_form = scanner->form;
-                synctex_node_p next_form = NULL;
-                while ((next_form = __synctex_tree_sibling(last_form))) {
-                    last_form = next_form;
-                }
-                __synctex_tree_set_sibling(last_form, node);
+                __synctex_tree_set_sibling(scanner->form_by_tag.last, node);
             } else {
                 scanner->form = node;
             }
+            scanner->form_by_tag.last = node;
+            _synctex_directory_add(&scanner->form_by_tag, _synctex_data_tag(node), node, synctex_NO);
             return (_synctex_ns_s){node, SYNCTEX_STATUS_OK};
         }
         _synctex_free_node(node);
@@ -5447,8 +7120,73 @@ static _synctex_ns_s _synctex_parse_new_form(synctex_scanner_p scanner)
 #define SYNCTEX_SHOULD_DECODE_FAILED(NODE, WHAT) (_synctex_data_has_##WHAT(NODE) && (_synctex_data_decode_##WHAT(NODE) < SYNCTEX_STATUS_OK))
 #define SYNCTEX_SHOULD_DECODE_FAILED_V(NODE, WHAT) (_synctex_data_has_##WHAT(NODE) && (_synctex_data_decode_##WHAT##_v(NODE) < SYNCTEX_STATUS_OK))
 
+/*  Box and leaf records are decoded at once when they fit in the buffer,
+ *  with only one bounds check per record.
+ *  - returns: SYNCTEX_STATUS_OK on success.
+ *      SYNCTEX_STATUS_NOT_OK when the fields must be decoded one at a time,
+ *      the cursor is unchanged in that case.
+ */
+#define SYNCTEX_RECORD_FIELD_MAX 8
+#define SYNCTEX_BUFFER_RECORD_SIZE 128
+#define SYNCTEX_RECORD_TAKE(NODE, WHAT)                          \
+    if (_synctex_data_has_##WHAT(NODE)) {                        \
+        if (i < n) {                                             \
+            _synctex_data_set_##WHAT(NODE, values[i++]);         \
+        } else {                                                 \
+            return SYNCTEX_STATUS_NOT_OK;                        \
+        }                                                        \
+    }
+static synctex_status_t __synctex_data_decode_tlchvwhd(synctex_node_p node)
+{
+    synctex_scanner_p scanner = node->class_->scanner;
+    int values[SYNCTEX_RECORD_FIELD_MAX];
+    char separators[SYNCTEX_RECORD_FIELD_MAX];
+    char *end = NULL;
+    int i = 0, n = 0;
+    _synctex_zs_s zs = _synctex_buffer_get_available_size(scanner, SYNCTEX_BUFFER_RECORD_SIZE);
+    if (zs.status < SYNCTEX_STATUS_EOF || zs.size == 0) {
+        return SYNCTEX_STATUS_NOT_OK;
+    }
+    n = synctex_parse_int_fields(scanner->parse_int, SYNCTEX_CUR, SYNCTEX_END, values, separators, SYNCTEX_RECORD_FIELD_MAX, &end);
+    SYNCTEX_RECORD_TAKE(node, tag);
+    SYNCTEX_RECORD_TAKE(node, line);
+    if (_synctex_data_has_column(node)) {
+        if (i < n) {
+            /*  The column is optional and comes with a comma */
+            _synctex_data_set_column(node, separators[i] == ',' ? values[i++] : SYNCTEX_DFLT_COLUMN);
+        } else {
+            return SYNCTEX_STATUS_NOT_OK;
+        }
+    }
+    SYNCTEX_RECORD_TAKE(node, h);
+    if (_synctex_data_has_v(node)) {
+        if (i < n) {
+            _synctex_data_set_v(node, scanner->reader->lastv = values[i++]);
+        } else if (end[0] == ',' && end[1] == '=') {
+            _synctex_data_set_v(node, scanner->reader->lastv);
+            n = synctex_parse_int_fields(scanner->parse_int, end + 2, SYNCTEX_END, values, separators, SYNCTEX_RECORD_FIELD_MAX, &end);
+            i = 0;
+        } else {
+            return SYNCTEX_STATUS_NOT_OK;
+        }
+    }
+    SYNCTEX_RECORD_TAKE(node, width);
+    SYNCTEX_RECORD_TAKE(node, height);
+    SYNCTEX_RECORD_TAKE(node, depth);
+    /*  The last field must not be truncated by the end of the buffer */
+    if (i < n || end >= SYNCTEX_END) {
+        return SYNCTEX_STATUS_NOT_OK;
+    }
+    SYNCTEX_CUR = end;
+    return SYNCTEX_STATUS_OK;
+}
+#undef SYNCTEX_RECORD_TAKE
+
 static synctex_status_t _synctex_data_decode_tlchvwhd(synctex_node_p node)
 {
+    if (__synctex_data_decode_tlchvwhd(node) == SYNCTEX_STATUS_OK) {
+        return 0;
+    }
     return SYNCTEX_SHOULD_DECODE_FAILED(node, tag) || SYNCTEX_SHOULD_DECODE_FAILED(node, line) || SYNCTEX_SHOULD_DECODE_FAILED(node, column)
         || SYNCTEX_SHOULD_DECODE_FAILED(node, h) || SYNCTEX_SHOULD_DECODE_FAILED_V(node, v) || SYNCTEX_SHOULD_DECODE_FAILED(node, width)
         || SYNCTEX_SHOULD_DECODE_FAILED(node, height) || SYNCTEX_SHOULD_DECODE_FAILED(node, depth);
@@ -5730,42 +7468,216 @@ static SYNCTEX_INLINE void _synctex_handle_make_friend_tlc(synctex_node_p node)
         node = __synctex_tree_sibling(node);
     }
 }
-/**
- *  Scan sheets, forms and input records.
- *  - parameter scanner: owning scanner
+/*  Location of SYNCTEX_CUR in the uncompressed synctex file.
+ *  The buffer always holds the characters just before the reader location.
+ */
+static z_off_t _synctex_scanner_tell(synctex_scanner_p scanner)
+{
+    if (scanner->reader->mapped) {
+        return SYNCTEX_CUR - SYNCTEX_START;
+    }
+    return _synctex_reader_tell(scanner->reader) - (SYNCTEX_END - SYNCTEX_CUR);
+}
+/*  Move SYNCTEX_CUR to the location recorded in the given entry.
+ *  When the location is still in the buffer, like the next sheet, the file is not seeked.
+ *  Otherwise the buffer is emptied such that the next read starts at that offset.
  *  - returns: status
  */
-static synctex_status_t __synctex_parse_sfi(synctex_scanner_p scanner)
+static synctex_status_t _synctex_scanner_seek(synctex_scanner_p scanner, const _synctex_sheet_entry_s *entry)
 {
-    synctex_status_t status = SYNCTEX_STATUS_OK;
-    _synctex_zs_s zs = {0, 0};
-    _synctex_ns_s input = SYNCTEX_NS_NULL;
-    synctex_node_p sheet = NULL;
-    synctex_node_p form = NULL;
-    synctex_node_p parent = NULL;
-    synctex_node_p child = NULL;
-    /*
-     *  Experimentations lead to the forthcoming conclusion:
-     *  Sometimes, the first nodes of a box have the wrong line number.
-     *  These are only boundary (x) nodes.
-     *  We observed that boundary nodes do have the proper line number
-     *  if they follow a node with a different type.
-     *  We keep track of these leading x nodes in a handle tree.
-     */
-    synctex_node_p x_handle = NULL;
-#define SYNCTEX_RETURN(STATUS)                                                                                                                                 \
-    _synctex_node_free(x_handle);                                                                                                                              \
-    return STATUS
-    synctex_node_p last_k = NULL;
-    synctex_node_p last_g = NULL;
-    _synctex_ns_s ns = SYNCTEX_NS_NULL;
-    int form_depth = 0;
-    int ignored_form_depth = 0;
-    synctex_bool_t try_input = synctex_YES;
-    if (!(x_handle = _synctex_new_handle(scanner))) {
-        SYNCTEX_RETURN(SYNCTEX_STATUS_ERROR);
+    z_off_t end = 0;
+    if (scanner->reader->mapped) {
+        if (entry->offset < 0 || (size_t)entry->offset > scanner->reader->size) {
+            _synctex_error("Can't seek file");
+            return SYNCTEX_STATUS_ERROR;
+        }
+        SYNCTEX_CUR = SYNCTEX_START + entry->offset;
+    } else if (_synctex_reader_is_open(scanner->reader) && (end = _synctex_reader_tell(scanner->reader)) >= entry->offset
+               && end - entry->offset <= SYNCTEX_END - SYNCTEX_START) {
+        /*  The buffer holds the characters just before the reader location. */
+        SYNCTEX_CUR = SYNCTEX_END - (end - entry->offset);
+    } else {
+        if (entry->offset != _synctex_reader_seek(scanner->reader, entry->offset)) {
+            _synctex_error("Can't seek file");
+            return SYNCTEX_STATUS_ERROR;
+        }
+        /*  Empty, the buffer holds no character before the reader location. */
+        SYNCTEX_CUR = SYNCTEX_END = SYNCTEX_START;
+        *SYNCTEX_END = '\0';
+#if defined(SYNCTEX_USE_CHARINDEX)
+        scanner->reader->charindex_offset = entry->offset - (SYNCTEX_END - SYNCTEX_START);
+#endif
     }
-#ifdef SYNCTEX_NOTHING
+    scanner->reader->line_number = entry->line_number;
+    scanner->reader->lastv = entry->lastv;
+    return SYNCTEX_STATUS_OK;
+}
+/*  Record the location of the sheet content in the sheet directory.
+ */
+static synctex_status_t _synctex_scanner_add_sheet_entry(synctex_scanner_p scanner, const _synctex_sheet_entry_s *entry)
+{
+    if (scanner->sheets.count == scanner->sheets.capacity) {
+        int capacity = scanner->sheets.capacity ? 2 * scanner->sheets.capacity : 64;
+        _synctex_sheet_entry_s *entries = realloc(scanner->sheets.entries, capacity * sizeof(_synctex_sheet_entry_s));
+        if (NULL == entries) {
+            _synctex_error("Memory problem");
+            return SYNCTEX_STATUS_ERROR;
+        }
+        scanner->sheets.entries = entries;
+        scanner->sheets.capacity = capacity;
+    }
+    scanner->sheets.entries[scanner->sheets.count++] = *entry;
+    ++scanner->sheets.pending;
+    /*  On failure, the entry is searched instead */
+    _synctex_directory_set_entry(&scanner->sheet_by_page, _synctex_data_page(entry->sheet), entry->sheet, scanner->sheets.count - 1);
+    return SYNCTEX_STATUS_OK;
+}
+/*  Records with a v field, that field may be the "=" shortcut for the last v decoded.
+ */
+static SYNCTEX_INLINE synctex_bool_t _synctex_char_has_v(char c)
+{
+    return c == SYNCTEX_CHAR_BEGIN_VBOX || c == SYNCTEX_CHAR_BEGIN_HBOX || c == SYNCTEX_CHAR_VOID_VBOX || c == SYNCTEX_CHAR_VOID_HBOX
+        || c == SYNCTEX_CHAR_KERN || c == SYNCTEX_CHAR_GLUE || c == SYNCTEX_CHAR_RULE || c == SYNCTEX_CHAR_MATH || c == SYNCTEX_CHAR_BOUNDARY
+        || c == SYNCTEX_CHAR_FORM_REF;
+}
+/*  Decode the v field of a complete record line in [ptr, eol).
+ *  The v field follows the first ',' after the first ':' of the line.
+ *  - returns: yorn, no for the "=" shortcut.
+ */
+static synctex_bool_t _synctex_scanner_decode_lastv(synctex_scanner_p scanner, char *ptr, char *eol)
+{
+    char *end = NULL;
+    int v = 0;
+    if ((ptr = memchr(ptr, ':', eol - ptr)) && (ptr = memchr(ptr, ',', eol - ptr)) && *++ptr != '=') {
+        v = (*scanner->parse_int)(ptr, &end);
+        if (end > ptr) {
+            scanner->reader->lastv = v;
+            return synctex_YES;
+        }
+    }
+    return synctex_NO;
+}
+/*  Update lastv with the last explicit v field of the complete lines in [first, last).
+ *  Lines are browsed backwards from the end, in general only a few ones are decoded.
+ */
+static void _synctex_scanner_update_lastv(synctex_scanner_p scanner, char *first, char *last)
+{
+    while (last > first) {
+        /*  last - 1 is the '\n' ending the current line */
+        char *eol = last - 1;
+        char *bol = eol;
+        while (bol > first && bol[-1] != '\n') {
+            --bol;
+        }
+        if (_synctex_char_has_v(*bol) && _synctex_scanner_decode_lastv(scanner, bol, eol)) {
+            return;
+        }
+        last = bol;
+    }
+}
+/*  Skip the content of a sheet in the first pass of a lazy parse,
+ *  the sheet record was just parsed.
+ *  Sheets that contain form definitions are not skipped because
+ *  forms must be available before any sheet content is parsed.
+ *  Lines are located with _synctex_find_eol and records are not decoded,
+ *  except the last v field before the buffer is refilled.
+ *  - returns: SYNCTEX_STATUS_OK when the content was skipped and recorded,
+ *      SYNCTEX_STATUS_NOT_OK when it must be parsed now,
+ *      SYNCTEX_CUR is then at the start of the content,
+ *      an error status otherwise.
+ */
+static synctex_status_t _synctex_skip_sheet(synctex_scanner_p scanner, synctex_node_p sheet)
+{
+    _synctex_sheet_entry_s entry = {sheet, _synctex_scanner_tell(scanner), scanner->reader->line_number, scanner->reader->lastv};
+    synctex_status_t status = SYNCTEX_STATUS_OK;
+    char *first = NULL;
+    char *eol = NULL;
+    _synctex_zs_s zs = {0, 0};
+    do {
+        /*  SYNCTEX_CUR is at the start of a line */
+        first = SYNCTEX_CUR;
+        while (SYNCTEX_CUR < SYNCTEX_END) {
+            if (*SYNCTEX_CUR == SYNCTEX_CHAR_END_SHEET) {
+                _synctex_scanner_update_lastv(scanner, first, SYNCTEX_CUR);
+                ++SYNCTEX_CUR;
+                if (_synctex_next_line(scanner) < SYNCTEX_STATUS_OK) {
+                    _synctex_error("Missing anchor.");
+                }
+                return _synctex_scanner_add_sheet_entry(scanner, &entry);
+            } else if (*SYNCTEX_CUR == SYNCTEX_CHAR_BEGIN_FORM) {
+                status = _synctex_scanner_seek(scanner, &entry);
+                return status < SYNCTEX_STATUS_OK ? status : SYNCTEX_STATUS_NOT_OK;
+            }
+            if ((eol = _synctex_find_eol(SYNCTEX_CUR, SYNCTEX_END)) == SYNCTEX_END) {
+                /*  Incomplete line */
+                break;
+            }
+            SYNCTEX_CUR = eol + 1;
+            ++scanner->reader->line_number;
+        }
+        /*  The buffer will be refilled, keep track of the last v field now. */
+        _synctex_scanner_update_lastv(scanner, first, SYNCTEX_CUR);
+        if (SYNCTEX_END - SYNCTEX_CUR < SYNCTEX_BUFFER_SIZE / 2) {
+            /*  Get the whole line */
+            zs = _synctex_buffer_get_available_size(scanner, SYNCTEX_END - SYNCTEX_CUR + 1);
+            status = zs.status;
+            if (status == SYNCTEX_STATUS_EOF && zs.size && _synctex_find_eol(SYNCTEX_CUR, SYNCTEX_END) == SYNCTEX_END) {
+                /*  The last line has no end of line marker */
+                SYNCTEX_CUR = SYNCTEX_END;
+            }
+        } else {
+            /*  Unexpectedly long line, ignore it */
+            status = _synctex_next_line(scanner);
+        }
+    } while (SYNCTEX_CUR < SYNCTEX_END && status >= SYNCTEX_STATUS_EOF);
+    if (status >= SYNCTEX_STATUS_EOF) {
+        _synctex_error("Incomplete synctex file, postamble missing.");
+        return SYNCTEX_STATUS_ERROR;
+    }
+    return status;
+}
+/**
+ *  Scan sheets, forms and input records.
+ *  - parameter scanner: owning scanner
+ *  - parameter the_sheet: when not NULL, only parse the content of this sheet,
+ *      the reader is expected to be located just after the sheet record.
+ *  - returns: status
+ */
+static synctex_status_t __synctex_parse_sfi(synctex_scanner_p scanner, synctex_node_p the_sheet)
+{
+    synctex_status_t status = SYNCTEX_STATUS_OK;
+    _synctex_zs_s zs = {0, 0};
+    _synctex_ns_s input = SYNCTEX_NS_NULL;
+    synctex_node_p sheet = NULL;
+    synctex_node_p form = NULL;
+    synctex_node_p parent = NULL;
+    synctex_node_p child = NULL;
+    /*
+     *  Experimentations lead to the forthcoming conclusion:
+     *  Sometimes, the first nodes of a box have the wrong line number.
+     *  These are only boundary (x) nodes.
+     *  We observed that boundary nodes do have the proper line number
+     *  if they follow a node with a different type.
+     *  We keep track of these leading x nodes in a handle tree.
+     */
+    synctex_node_p x_handle = NULL;
+#define SYNCTEX_RETURN(STATUS)                                                                                                                                 \
+    _synctex_node_free(x_handle);                                                                                                                              \
+    return STATUS
+    synctex_node_p last_k = NULL;
+    synctex_node_p last_g = NULL;
+    _synctex_ns_s ns = SYNCTEX_NS_NULL;
+    int form_depth = 0;
+    int ignored_form_depth = 0;
+    synctex_bool_t try_input = synctex_YES;
+    if (!(x_handle = _synctex_new_handle(scanner))) {
+        SYNCTEX_RETURN(SYNCTEX_STATUS_ERROR);
+    }
+    if (the_sheet) {
+        sheet = parent = the_sheet;
+        goto content_loop;
+    }
+#ifdef SYNCTEX_NOTHING
 #pragma mark MAIN LOOP
 #endif
 main_loop:
@@ -5806,6 +7718,14 @@ main_loop:
             try_input = synctex_YES;
             ns = _synctex_parse_new_sheet(scanner);
             if (ns.status == SYNCTEX_STATUS_OK) {
+                if (scanner->flags.lazy) {
+                    status = _synctex_skip_sheet(scanner, ns.node);
+                    if (status == SYNCTEX_STATUS_OK) {
+                        goto main_loop;
+                    } else if (status < SYNCTEX_STATUS_EOF) {
+                        SYNCTEX_RETURN(status);
+                    }
+                }
                 sheet = ns.node;
                 parent = sheet;
                 last_k = last_g = NULL;
@@ -5947,6 +7867,7 @@ content_loop:
                     /*  only void v boxes are friends */
                     _synctex_node_make_friend_tlc(parent);
                 }
+                _synctex_node_count_friends(parent);
                 child = parent;
                 parent = _synctex_tree_parent(child);
                 if (!form) {
@@ -6078,6 +7999,7 @@ content_loop:
                             child = next;
                         }
                     }
+                    _synctex_node_count_friends(parent);
                     child = parent;
                     parent = _synctex_tree_parent(child);
                     if (!form) {
@@ -6332,6 +8254,9 @@ _synctex_make_hbox_contain_box(parent,_synctex_data_box(child));
                     _synctex_error("Missing anchor.");
                 }
                 parent = sheet = NULL;
+                if (the_sheet) {
+                    SYNCTEX_RETURN(SYNCTEX_STATUS_OK);
+                }
                 goto main_loop;
             }
         } else if (SYNCTEX_START_SCAN(END_FORM)) {
@@ -6405,6 +8330,7 @@ static SYNCTEX_INLINE _synctex_ns_s __synctex_replace_ref(synctex_node_p ref)
             _synctex_node_set_sibling(arg_sibling, ns.node);
             /*  Then append the original sibling of ref. */
             _synctex_node_set_sibling(ns.node, sibling);
+            _synctex_node_count_friends(parent);
 #if defined(SYNCTEX_USE_CHARINDEX)
             if (synctex_node_type(sibling) == synctex_node_type_box_bdry) {
                 /*  The sibling is the last box boundary
@@ -6484,8 +8410,8 @@ static SYNCTEX_INLINE synctex_status_t _synctex_post_process_proxy(synctex_node_
             printf("POST PROCESSING %s\n", _synctex_node_abstract(proxy));
             {
                 int i, j = 0;
-                for (i = 0; i < proxy->class_->scanner->number_of_lists; ++i) {
-                    synctex_node_p N = proxy->class_->scanner->lists_of_friends[i];
+                for (i = 0; i < proxy->class_->scanner->friends.capacity; ++i) {
+                    synctex_node_p N = proxy->class_->scanner->friends.entries[i].node;
                     do {
                         if (N == proxy) {
                             ++j;
@@ -6502,8 +8428,8 @@ static SYNCTEX_INLINE synctex_status_t _synctex_post_process_proxy(synctex_node_
 #if SYNCTEX_DEBUG > 500
             {
                 int i, j = 0;
-                for (i = 0; i < proxy->class_->scanner->number_of_lists; ++i) {
-                    synctex_node_p N = proxy->class_->scanner->lists_of_friends[i];
+                for (i = 0; i < proxy->class_->scanner->friends.capacity; ++i) {
+                    synctex_node_p N = proxy->class_->scanner->friends.entries[i].node;
                     do {
                         if (N == proxy) {
                             ++j;
@@ -6521,8 +8447,8 @@ static SYNCTEX_INLINE synctex_status_t _synctex_post_process_proxy(synctex_node_
 #if SYNCTEX_DEBUG > 500
             if (proxy) {
                 int i, j = 0;
-                for (i = 0; i < proxy->class_->scanner->number_of_lists; ++i) {
-                    synctex_node_p N = proxy->class_->scanner->lists_of_friends[i];
+                for (i = 0; i < proxy->class_->scanner->friends.capacity; ++i) {
+                    synctex_node_p N = proxy->class_->scanner->friends.entries[i].node;
                     do {
                         if (N == proxy) {
                             ++j;
@@ -6540,6 +8466,201 @@ static SYNCTEX_INLINE synctex_status_t _synctex_post_process_proxy(synctex_node_
     }
     return SYNCTEX_STATUS_OK;
 }
+
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark Pending proxies
+#endif
+
+/*  A form used on every page would multiply the number of nodes
+ *  if the root proxies replacing its refs in the sheets were expanded
+ *  at parse time. Instead, their hierarchy is created and registered
+ *  as friends on demand: before the geometry of their sheet is built,
+ *  and before a display query for a tag and line used in their form.
+ */
+static int _synctex_proxy_entry_cmp(const void *a, const void *b)
+{
+    const _synctex_proxy_entry_s *l = a;
+    const _synctex_proxy_entry_s *r = b;
+    if (l->form != r->form) {
+        return l->form->index < r->form->index ? -1 : 1;
+    }
+    return l->proxy->index < r->proxy->index ? -1 : l->proxy->index > r->proxy->index;
+}
+/*  Record the root proxies linked through their friend field.
+ *  On allocation failure, their hierarchies are registered at once.
+ */
+static void _synctex_scanner_add_proxies(synctex_scanner_p scanner, synctex_node_p proxy)
+{
+    int count = scanner->proxies.count;
+    while (proxy) {
+        synctex_node_p next = NULL;
+        synctex_node_p form = _synctex_tree_parent(_synctex_tree_target(proxy));
+        if (scanner->proxies.count == scanner->proxies.capacity) {
+            int capacity = scanner->proxies.capacity ? 2 * scanner->proxies.capacity : 64;
+            _synctex_proxy_entry_s *entries = realloc(scanner->proxies.entries, capacity * sizeof(_synctex_proxy_entry_s));
+            if (NULL == entries) {
+                _synctex_post_process_proxy(proxy, &__synctex_proxy_make_friend_and_next_hbox);
+                break;
+            }
+            scanner->proxies.entries = entries;
+            scanner->proxies.capacity = capacity;
+        }
+        next = _synctex_tree_reset_friend(proxy);
+        if (form) {
+            scanner->proxies.entries[scanner->proxies.count++] = (_synctex_proxy_entry_s){form, proxy};
+        } else {
+            _synctex_post_process_proxy(proxy, &__synctex_proxy_make_friend_and_next_hbox);
+        }
+        proxy = next;
+    }
+    if (scanner->proxies.count > count && scanner->proxies.count > 1) {
+        scanner->proxies.unsorted = synctex_YES;
+    }
+}
+/*  Sort the pending proxies by form, once before they are used,
+ *  instead of each time the proxies of a lazily parsed sheet are added.
+ *  The order does not depend on when the proxies were added.
+ */
+static void _synctex_scanner_sort_proxies(synctex_scanner_p scanner)
+{
+    if (scanner->proxies.unsorted) {
+        qsort(scanner->proxies.entries, scanner->proxies.count, sizeof(_synctex_proxy_entry_s), &_synctex_proxy_entry_cmp);
+        scanner->proxies.unsorted = synctex_NO;
+    }
+}
+/*  Create and register the hierarchies of the pending proxies in [begin, end).
+ */
+static void _synctex_scanner_register_proxies(synctex_scanner_p scanner, int begin, int end)
+{
+    int i;
+    for (i = begin; i < end; ++i) {
+        _synctex_post_process_proxy(scanner->proxies.entries[i].proxy, &__synctex_proxy_make_friend_and_next_hbox);
+    }
+    memmove(scanner->proxies.entries + begin, scanner->proxies.entries + end, (scanner->proxies.count - end) * sizeof(_synctex_proxy_entry_s));
+    scanner->proxies.count -= end - begin;
+}
+/*  Create and register the hierarchies of the pending proxies in the given sheet.
+ *  Proxies of sheets with the same page are registered too, which is harmless.
+ */
+static void _synctex_scanner_register_sheet_proxies(synctex_scanner_p scanner, synctex_node_p sheet)
+{
+    int page = _synctex_data_page(sheet);
+    int i, j;
+    _synctex_scanner_sort_proxies(scanner);
+    for (i = j = 0; i < scanner->proxies.count; ++i) {
+        _synctex_proxy_entry_s entry = scanner->proxies.entries[i];
+        if (synctex_node_page(entry.proxy) == page) {
+            _synctex_post_process_proxy(entry.proxy, &__synctex_proxy_make_friend_and_next_hbox);
+        } else {
+            scanner->proxies.entries[j++] = entry;
+        }
+    }
+    scanner->proxies.count = j;
+}
+static int _synctex_form_line_cmp(const void *a, const void *b)
+{
+    const _synctex_friend_s *l = a;
+    const _synctex_friend_s *r = b;
+    if (l->tag != r->tag) {
+        return l->tag < r->tag ? -1 : 1;
+    }
+    if (l->line != r->line) {
+        return l->line < r->line ? -1 : 1;
+    }
+    return l->node->index < r->node->index ? -1 : l->node->index > r->node->index;
+}
+/*  Collect the tags and lines of the targets of the proxies to the forms,
+ *  possibly more, once the forms are known.
+ *  - returns: yorn, no on allocation failure.
+ */
+static synctex_bool_t _synctex_scanner_index_form_lines(synctex_scanner_p scanner)
+{
+    _synctex_friend_s *entries = NULL;
+    int count = 0;
+    int capacity = 0;
+    int i, j;
+    synctex_node_p form = NULL;
+    if (scanner->form_lines.entries && scanner->form_lines.last == scanner->form_by_tag.last) {
+        return synctex_YES;
+    }
+    for (form = scanner->form; form; form = __synctex_tree_sibling(form)) {
+        synctex_node_p node = _synctex_tree_child(form);
+        while (node) {
+            synctex_node_p next = NULL;
+            synctex_node_p target = _synctex_tree_target(node);
+            if (count + 2 > capacity) {
+                _synctex_friend_s *more = realloc(entries, (capacity = capacity ? 2 * capacity : 256) * sizeof(_synctex_friend_s));
+                if (NULL == more) {
+                    free(entries);
+                    return synctex_NO;
+                }
+                entries = more;
+            }
+            /*  The proxies to this node target either the node or its own target. */
+            entries[count++] = (_synctex_friend_s){_synctex_data_tag(node), _synctex_data_line(node), form};
+            if (target) {
+                entries[count++] = (_synctex_friend_s){_synctex_data_tag(target), _synctex_data_line(target), form};
+            }
+            /*  Creates the child proxies of the forms used in this form. */
+            if ((next = synctex_node_child(node))) {
+                node = next;
+                continue;
+            }
+            while (node != form && NULL == (next = __synctex_tree_sibling(node))) {
+                node = _synctex_tree_parent(node);
+            }
+            node = node == form ? NULL : next;
+        }
+    }
+    if (count > 1) {
+        qsort(entries, count, sizeof(_synctex_friend_s), &_synctex_form_line_cmp);
+    }
+    for (i = j = 0; i < count; ++i) {
+        if (0 == j || _synctex_form_line_cmp(entries + j - 1, entries + i)) {
+            entries[j++] = entries[i];
+        }
+    }
+    free(scanner->form_lines.entries);
+    scanner->form_lines.entries = entries;
+    scanner->form_lines.count = j;
+    scanner->form_lines.last = scanner->form_by_tag.last;
+    return synctex_YES;
+}
+/*  Create and register the hierarchies of the pending proxies
+ *  to the forms using the given tag and lines.
+ */
+static void _synctex_scanner_register_line_proxies(synctex_scanner_p scanner, int tag, int first, int last)
+{
+    _synctex_friend_s *entries = NULL;
+    int i, count = 0;
+    if (0 == scanner->proxies.count) {
+        return;
+    }
+    _synctex_scanner_sort_proxies(scanner);
+    if (!_synctex_scanner_index_form_lines(scanner)) {
+        _synctex_scanner_register_proxies(scanner, 0, scanner->proxies.count);
+        return;
+    }
+    entries = _synctex_keys_range(scanner->form_lines.entries, scanner->form_lines.count, tag, first, last, &count);
+    for (i = 0; i < count; ++i) {
+        synctex_node_p form = entries[i].node;
+        int begin = 0, end = scanner->proxies.count;
+        while (begin < end) {
+            int middle = begin + (end - begin) / 2;
+            if (scanner->proxies.entries[middle].form->index < form->index) {
+                begin = middle + 1;
+            } else {
+                end = middle;
+            }
+        }
+        for (end = begin; end < scanner->proxies.count && scanner->proxies.entries[end].form == form; ++end) {
+        }
+        if (end > begin) {
+            _synctex_scanner_register_proxies(scanner, begin, end);
+        }
+    }
+}
 /**
  *  Replace all the form refs by root box proxies.
  *  Create the node hierarchy and update the friends.
@@ -6591,10 +8712,10 @@ static SYNCTEX_INLINE synctex_status_t _synctex_post_process(synctex_scanner_p s
 #if 0
     {
         int i;
-        for (i=0;i<scanner->number_of_lists;++i) {
+        for (i=0;i<scanner->friends.capacity;++i) {
             synctex_node_p P = ns.node;
             do {
-                synctex_node_p N = scanner->lists_of_friends[i];
+                synctex_node_p N = scanner->friends.entries[i].node;
                 do {
                     if (P == N) {
                         printf("Already registered.\n");
@@ -6609,8 +8730,8 @@ static SYNCTEX_INLINE synctex_status_t _synctex_post_process(synctex_scanner_p s
 #if SYNCTEX_DEBUG > 10000
     {
         int i;
-        for (i = 0; i < scanner->number_of_lists; ++i) {
-            synctex_node_p P = scanner->lists_of_friends[i];
+        for (i = 0; i < scanner->friends.capacity; ++i) {
+            synctex_node_p P = scanner->friends.entries[i].node;
             int j = 0;
             while (P) {
                 ++j;
@@ -6623,9 +8744,11 @@ static SYNCTEX_INLINE synctex_status_t _synctex_post_process(synctex_scanner_p s
         }
     }
 #endif
-    ns.status = _synctex_post_process_proxy(ns.node, &__synctex_proxy_make_friend_and_next_hbox);
-    if (ns.status < status) {
-        status = ns.status;
+    /*  The hierarchies of the sheet proxies are created on demand */
+    _synctex_scanner_add_proxies(scanner, ns.node);
+    /*  The mapped lines, display queries fall back to unmapped lines on failure */
+    if (0 == scanner->sheets.pending) {
+        _synctex_scanner_index_lines(scanner);
     }
 #if SYNCTEX_DEBUG > 500
     printf("!  exiting _synctex_post_process.\n");
@@ -6637,6 +8760,20 @@ static SYNCTEX_INLINE synctex_status_t _synctex_post_process(synctex_scanner_p s
 #endif
     return status;
 }
+/*  Replace the form refs of the sheets parsed since the last post processing by root proxies.
+ *  Unlike _synctex_post_process, the form refs inside forms must already be replaced.
+ */
+static synctex_status_t _synctex_post_process_sheets(synctex_scanner_p scanner)
+{
+    _synctex_ns_s ns = _synctex_post_process_ref(scanner->ref_in_sheet);
+    scanner->ref_in_sheet = NULL;
+    /*  The hierarchies of the sheet proxies are created on demand */
+    _synctex_scanner_add_proxies(scanner, ns.node);
+    if (0 == scanner->sheets.pending) {
+        _synctex_scanner_index_lines(scanner);
+    }
+    return ns.status;
+}
 /*  Used when parsing the synctex file
  */
 static synctex_status_t _synctex_scan_content(synctex_scanner_p scanner)
@@ -6659,106 +8796,438 @@ content_not_found:
     if (status == SYNCTEX_STATUS_NOT_OK) {
         goto content_not_found;
     }
-    status = __synctex_parse_sfi(scanner);
+    status = __synctex_parse_sfi(scanner, NULL);
     if (status == SYNCTEX_STATUS_OK) {
         status = _synctex_post_process(scanner);
     }
     return status;
 }
-synctex_scanner_p synctex_scanner_new()
+/*  Parse the content of the sheet of the given entry.
+ */
+static synctex_status_t _synctex_scanner_parse_content(synctex_scanner_p scanner, const _synctex_sheet_entry_s *entry)
 {
-    synctex_scanner_p scanner = (synctex_scanner_p)_synctex_malloc(sizeof(_synctex_scanner_s));
-    if (scanner) {
-        if (!(scanner->reader = _synctex_malloc(sizeof(_synctex_reader_s)))) {
-            _synctex_free(scanner);
-            return NULL;
-        }
-
-#define DEFINE_synctex_scanner_class(NAME)                                                                                                                     \
-    scanner->class_[synctex_node_type_##NAME] = _synctex_class_##NAME;                                                                                         \
-    (scanner->class_[synctex_node_type_##NAME]).scanner = scanner
-
-        DEFINE_synctex_scanner_class(input);
-        DEFINE_synctex_scanner_class(sheet);
-        DEFINE_synctex_scanner_class(form);
-        DEFINE_synctex_scanner_class(hbox);
-        DEFINE_synctex_scanner_class(void_hbox);
-        DEFINE_synctex_scanner_class(vbox);
-        DEFINE_synctex_scanner_class(void_vbox);
-        DEFINE_synctex_scanner_class(kern);
-        DEFINE_synctex_scanner_class(glue);
-        DEFINE_synctex_scanner_class(rule);
-        DEFINE_synctex_scanner_class(math);
-        DEFINE_synctex_scanner_class(boundary);
-        DEFINE_synctex_scanner_class(box_bdry);
-        DEFINE_synctex_scanner_class(ref);
-        DEFINE_synctex_scanner_class(proxy_hbox);
-        DEFINE_synctex_scanner_class(proxy_vbox);
-        DEFINE_synctex_scanner_class(proxy);
-        DEFINE_synctex_scanner_class(proxy_last);
-        DEFINE_synctex_scanner_class(handle);
-        /*  set up the lists of friends */
-        scanner->number_of_lists = 1024;
-        scanner->lists_of_friends = (synctex_node_r)_synctex_malloc(scanner->number_of_lists * sizeof(synctex_node_p));
-        if (NULL == scanner->lists_of_friends) {
-            synctex_scanner_free(scanner);
-            _synctex_error("malloc:2");
-            return NULL;
-        }
-        scanner->display_switcher = 100;
-        scanner->display_prompt = (char *)_synctex_display_prompt + strlen(_synctex_display_prompt) - 1;
+    synctex_status_t status = _synctex_scanner_seek(scanner, entry);
+    if (status == SYNCTEX_STATUS_OK) {
+        status = __synctex_parse_sfi(scanner, entry->sheet);
     }
-    return scanner;
+    if (status < SYNCTEX_STATUS_OK) {
+        _synctex_error("Bad sheet content\n");
+    }
+    return status;
 }
-/*  Where the synctex scanner is created. */
-synctex_scanner_p synctex_scanner_new_with_output_file(const char *output, const char *build_directory, int parse)
+/*  Parse the content of a sheet skipped by a lazy parse.
+ *  The form refs are not yet replaced by proxies.
+ */
+static synctex_status_t _synctex_scanner_parse_entry(synctex_scanner_p scanner, _synctex_sheet_entry_s *entry)
 {
-    synctex_scanner_p scanner = synctex_scanner_new();
-    if (NULL == scanner) {
-        _synctex_error("malloc problem");
-        return NULL;
+    synctex_status_t status = _synctex_scanner_parse_content(scanner, entry);
+    entry->sheet = NULL;
+    --scanner->sheets.pending;
+    return status;
+}
+/*  Replace the form refs of the sheets just parsed
+ *  and close the file once all the sheets are parsed.
+ *  The forms were post processed with the content parsed first,
+ *  only the refs of these sheets remain.
+ */
+static void _synctex_scanner_did_parse_entries(synctex_scanner_p scanner)
+{
+    if ((scanner->ref_in_form ? _synctex_post_process(scanner) : _synctex_post_process_sheets(scanner)) < SYNCTEX_STATUS_OK) {
+        _synctex_error("Bad sheet content\n");
     }
-    if (synctex_reader_init_with_output_file(scanner->reader, output, build_directory)) {
-        return parse ? synctex_scanner_parse(scanner) : scanner;
+    if (0 == scanner->sheets.pending) {
+        _synctex_reader_free_buffer(scanner->reader);
+        _synctex_reader_close(scanner->reader);
     }
-    // don't warn to terminal if no file is present, this is a library.
-    // _synctex_error("No file?");
-    synctex_scanner_free(scanner);
-    return NULL;
 }
-
-/*  The scanner destructor
+/*  The index of the entry of the given sheet, -1 if its content is already parsed.
+ *  Only used when the sheet directory could not record the entry.
  */
-int synctex_scanner_free(synctex_scanner_p scanner)
+static int _synctex_scanner_sheet_entry(synctex_scanner_p scanner, synctex_node_p sheet)
 {
-    int node_count = 0;
-    if (scanner) {
-        _synctex_node_free(scanner->sheet);
-        _synctex_node_free(scanner->form);
-        _synctex_node_free(scanner->input);
-        synctex_reader_free(scanner->reader);
-        SYNCTEX_SCANNER_FREE_HANDLE(scanner);
-        synctex_iterator_free(scanner->iterator);
-        free(scanner->output_fmt);
-        free(scanner->lists_of_friends);
-#if SYNCTEX_USE_NODE_COUNT > 0
-        node_count = scanner->node_count;
-#endif
-        free(scanner);
+    int i;
+    for (i = 0; scanner->sheets.pending && i < scanner->sheets.count; ++i) {
+        if (scanner->sheets.entries[i].sheet == sheet) {
+            return i;
+        }
     }
-    return node_count;
+    return -1;
 }
-
-/*  Where the synctex scanner parses the contents of the file. */
-synctex_scanner_p synctex_scanner_parse(synctex_scanner_p scanner)
+/*  Ensure that the content of the sheet of the given entry is parsed.
+ *  - argument i: an index in the sheet directory, -1 for none.
+ */
+static void _synctex_scanner_parse_sheet(synctex_scanner_p scanner, int i)
 {
-    synctex_status_t status = 0;
-    if (!scanner || scanner->flags.has_parsed) {
-        return scanner;
+    if (i >= 0 && i < scanner->sheets.count && scanner->sheets.entries[i].sheet) {
+        _synctex_scanner_parse_entry(scanner, scanner->sheets.entries + i);
+        _synctex_scanner_did_parse_entries(scanner);
     }
-    scanner->flags.has_parsed = 1;
-    scanner->pre_magnification = 1000;
-    scanner->pre_unit = 8192;
+}
+#if SYNCTEX_USE_THREADS
+/*  At most that many threads parse the sheets */
+#define SYNCTEX_THREADS_MAX 64
+/*  A range of the sheet directory parsed by a worker scanner on its own thread.
+ *  The worker allocates its nodes in slabs added to the table of its owner,
+ *  records the friends to register and the last lines of the inputs in shadow input nodes,
+ *  the owner merges all that afterwards.
+ */
+typedef struct {
+    synctex_scanner_p scanner;
+    _synctex_sheet_entry_s *entries;
+    int count;
+    size_t size;
+    pthread_t thread;
+    synctex_bool_t started;
+} _synctex_worker_s;
+
+/*  The slabs and the content of the reader belong to the owner. */
+static void _synctex_worker_free(synctex_scanner_p worker)
+{
+    worker->arena.slabs = NULL;
+    worker->arena.slab_count = 0;
+    memset(worker->reader, 0, sizeof(_synctex_reader_s));
+    worker->input = NULL;
+    synctex_scanner_free(worker);
+}
+/*  A scanner sharing the content, the slab table and the parse options of its owner.
+ *  - argument size: the number of bytes to parse, to size the slabs.
+ */
+static synctex_scanner_p _synctex_worker_new(synctex_scanner_p owner, _synctex_slab_table_s *table, size_t size)
+{
+    synctex_scanner_p worker = synctex_scanner_new();
+    synctex_node_p input = NULL;
+    if (NULL == worker) {
+        return NULL;
+    }
+    *worker->reader = *owner->reader;
+    worker->reader->file = NULL;
+    worker->reader->zindex = NULL;
+    worker->reader->pipe = NULL;
+    worker->reader->output = worker->reader->synctex = NULL;
+    worker->parse_int = owner->parse_int;
+    worker->flags.deferred = 1;
+    worker->arena.slabs = owner->arena.slabs;
+    worker->arena.table = table;
+    worker->arena.hint = size / SYNCTEX_BYTES_PER_RECORD + 1;
+    for (input = owner->input; input; input = __synctex_tree_sibling(input)) {
+        synctex_node_p shadow = _synctex_new_input(worker);
+        if (NULL == shadow) {
+            _synctex_worker_free(worker);
+            return NULL;
+        }
+        _synctex_data_set_tag(shadow, _synctex_data_tag(input));
+        __synctex_tree_set_sibling(shadow, worker->input);
+        worker->input = shadow;
+        if (_synctex_directory_add(&worker->input_by_tag, _synctex_data_tag(shadow), shadow, synctex_YES) < SYNCTEX_STATUS_OK) {
+            _synctex_worker_free(worker);
+            return NULL;
+        }
+    }
+    return worker;
+}
+static void *_synctex_worker_parse(void *arg)
+{
+    _synctex_worker_s *worker = arg;
+    int i;
+    for (i = 0; i < worker->count; ++i) {
+        if (worker->entries[i].sheet) {
+            _synctex_scanner_parse_content(worker->scanner, worker->entries + i);
+        }
+    }
+    return NULL;
+}
+/*  Give the given nodes, their siblings and their descendants the classes of the scanner. */
+static void _synctex_scanner_adopt(synctex_scanner_p scanner, synctex_node_p node)
+{
+    for (; node; node = __synctex_tree_sibling(node)) {
+        node->class_ = scanner->class_ + node->class_->type;
+        _synctex_scanner_adopt(scanner, _synctex_tree_child(node));
+    }
+}
+/*  Take over the sheets parsed by the worker, then free the worker.
+ *  Workers are merged in the order of their sheets.
+ */
+static void _synctex_scanner_merge_worker(synctex_scanner_p scanner, _synctex_worker_s *worker)
+{
+    synctex_scanner_p W = worker->scanner;
+    synctex_node_p node = NULL;
+    int i;
+    for (i = 0; i < worker->count; ++i) {
+        if (worker->entries[i].sheet) {
+            _synctex_scanner_adopt(scanner, _synctex_tree_child(worker->entries[i].sheet));
+            worker->entries[i].sheet = NULL;
+            --scanner->sheets.pending;
+        }
+    }
+    /*  Register the friends like a sequential parse would have done */
+    for (i = 0; i < W->deferred.count; ++i) {
+        __synctex_node_make_friend(W->deferred.entries[i].node, W->deferred.entries[i].tag, W->deferred.entries[i].line);
+    }
+    /*  Prepend the form refs, they are listed from the last one */
+    if ((node = W->ref_in_sheet)) {
+        synctex_node_p next = NULL;
+        while ((next = _synctex_tree_friend(node))) {
+            node = next;
+        }
+        synctex_tree_set_friend(node, scanner->ref_in_sheet);
+        scanner->ref_in_sheet = W->ref_in_sheet;
+    }
+    for (node = W->input; node; node = __synctex_tree_sibling(node)) {
+        synctex_node_p input = synctex_scanner_input_with_tag(scanner, _synctex_data_tag(node));
+        if (input && _synctex_data_line(node) > _synctex_data_line(input)) {
+            _synctex_data_set_line(input, _synctex_data_line(node));
+        }
+    }
+    /*  The nodes freed later go to the pools of the scanner */
+    for (i = 0; i < synctex_node_number_of_types; ++i) {
+        if (W->arena.pool_of[i]) {
+            _synctex_scanner_pool(scanner, (synctex_node_type_t)i, W->arena.pools[W->arena.pool_of[i] - 1].size);
+        }
+    }
+    _synctex_worker_free(W);
+}
+/*  The number of bytes of the content of the sheet of the entry, forms in between included */
+static size_t _synctex_scanner_entry_size(synctex_scanner_p scanner, int i)
+{
+    z_off_t end = i + 1 < scanner->sheets.count ? scanner->sheets.entries[i + 1].offset : (z_off_t)scanner->reader->size;
+    return end > scanner->sheets.entries[i].offset ? (size_t)(end - scanner->sheets.entries[i].offset) : 0;
+}
+/*  Parse the pending sheets on several threads, see synctex_parse_options_s.
+ *  The directory is split in ranges of sheets with about the same size, one for each worker.
+ *  The content must be in memory, mapped or loaded.
+ *  The result does not depend on the number of threads.
+ *  - returns: yorn, no when nothing was parsed.
+ */
+static synctex_bool_t _synctex_scanner_parse_sheets_in_parallel(synctex_scanner_p scanner)
+{
+    _synctex_worker_s workers[SYNCTEX_THREADS_MAX];
+    _synctex_slab_table_s table;
+    _synctex_slab_s **slabs = NULL;
+    unsigned long long total = 0, done = 0, previous = 0;
+    int n = scanner->threads < SYNCTEX_THREADS_MAX ? scanner->threads : SYNCTEX_THREADS_MAX;
+    int first = 0, i = 0, w = 0;
+    if (n > scanner->sheets.pending) {
+        n = scanner->sheets.pending;
+    }
+    if (n < 2 || !scanner->reader->mapped) {
+        return synctex_NO;
+    }
+    for (i = 0; i < scanner->sheets.count; ++i) {
+        if (scanner->sheets.entries[i].sheet) {
+            total += _synctex_scanner_entry_size(scanner, i);
+        }
+    }
+    for (i = 0; i < scanner->sheets.count && w < n; ++i) {
+        if (scanner->sheets.entries[i].sheet) {
+            done += _synctex_scanner_entry_size(scanner, i);
+        }
+        if ((w + 1 < n && done * n >= total * (w + 1)) || i + 1 == scanner->sheets.count) {
+            workers[w].entries = scanner->sheets.entries + first;
+            workers[w].count = i + 1 - first;
+            workers[w].size = (size_t)(done - previous);
+            previous = done;
+            first = i + 1;
+            ++w;
+        }
+    }
+    n = w;
+    /*  The slab table is not reallocated while the workers read it */
+    if (NULL == (slabs = realloc(scanner->arena.slabs, SYNCTEX_SLAB_MAX_COUNT * sizeof(_synctex_slab_s *)))) {
+        return synctex_NO;
+    }
+    scanner->arena.slabs = slabs;
+    scanner->arena.slab_capacity = SYNCTEX_SLAB_MAX_COUNT;
+    if (pthread_mutex_init(&table.mutex, NULL)) {
+        return synctex_NO;
+    }
+    table.owner = scanner;
+    for (w = 0; w < n; ++w) {
+        if (NULL == (workers[w].scanner = _synctex_worker_new(scanner, &table, workers[w].size))) {
+            while (w--) {
+                _synctex_worker_free(workers[w].scanner);
+            }
+            pthread_mutex_destroy(&table.mutex);
+            return synctex_NO;
+        }
+    }
+    /*  The calling thread parses the first range and the ranges of the threads that could not start */
+    for (w = 1; w < n; ++w) {
+        workers[w].started = 0 == pthread_create(&workers[w].thread, NULL, &_synctex_worker_parse, workers + w);
+    }
+    _synctex_worker_parse(workers);
+    for (w = 1; w < n; ++w) {
+        if (workers[w].started) {
+            pthread_join(workers[w].thread, NULL);
+        } else {
+            _synctex_worker_parse(workers + w);
+        }
+    }
+    for (w = 0; w < n; ++w) {
+        _synctex_scanner_merge_worker(scanner, workers + w);
+    }
+    pthread_mutex_destroy(&table.mutex);
+    if ((slabs = realloc(scanner->arena.slabs, (scanner->arena.slab_count + 1) * sizeof(_synctex_slab_s *)))) {
+        scanner->arena.slabs = slabs;
+        scanner->arena.slab_capacity = scanner->arena.slab_count + 1;
+    }
+    return synctex_YES;
+}
+#endif
+/*  Ensure that the content of all the sheets is parsed.
+ *  Sheets are parsed in the order of the file and form refs are replaced afterwards,
+ *  like in a full parse, such that the lists of friends are the same.
+ */
+static void _synctex_scanner_parse_sheets(synctex_scanner_p scanner)
+{
+    if (scanner->sheets.pending) {
+        int i;
+#if SYNCTEX_USE_THREADS
+        _synctex_scanner_parse_sheets_in_parallel(scanner);
+#endif
+        for (i = 0; i < scanner->sheets.count; ++i) {
+            if (scanner->sheets.entries[i].sheet) {
+                _synctex_scanner_parse_entry(scanner, scanner->sheets.entries + i);
+            }
+        }
+        _synctex_scanner_did_parse_entries(scanner);
+    }
+}
+synctex_scanner_p synctex_scanner_new()
+{
+    synctex_scanner_p scanner = (synctex_scanner_p)_synctex_malloc(sizeof(_synctex_scanner_s));
+    if (scanner) {
+        if (!(scanner->reader = _synctex_malloc(sizeof(_synctex_reader_s)))) {
+            _synctex_free(scanner);
+            return NULL;
+        }
+
+#define DEFINE_synctex_scanner_class(NAME)                                                                                                                     \
+    scanner->class_[synctex_node_type_##NAME] = _synctex_class_##NAME;                                                                                         \
+    (scanner->class_[synctex_node_type_##NAME]).scanner = scanner
+
+        DEFINE_synctex_scanner_class(input);
+        DEFINE_synctex_scanner_class(sheet);
+        DEFINE_synctex_scanner_class(form);
+        DEFINE_synctex_scanner_class(hbox);
+        DEFINE_synctex_scanner_class(void_hbox);
+        DEFINE_synctex_scanner_class(vbox);
+        DEFINE_synctex_scanner_class(void_vbox);
+        DEFINE_synctex_scanner_class(kern);
+        DEFINE_synctex_scanner_class(glue);
+        DEFINE_synctex_scanner_class(rule);
+        DEFINE_synctex_scanner_class(math);
+        DEFINE_synctex_scanner_class(boundary);
+        DEFINE_synctex_scanner_class(box_bdry);
+        DEFINE_synctex_scanner_class(ref);
+        DEFINE_synctex_scanner_class(proxy_hbox);
+        DEFINE_synctex_scanner_class(proxy_vbox);
+        DEFINE_synctex_scanner_class(proxy);
+        DEFINE_synctex_scanner_class(proxy_last);
+        DEFINE_synctex_scanner_class(handle);
+        /*  set up the index of friends */
+        if (_synctex_scanner_grow_friends(scanner) < SYNCTEX_STATUS_OK) {
+            synctex_scanner_free(scanner);
+            _synctex_error("malloc:2");
+            return NULL;
+        }
+        scanner->parse_int = synctex_parse_int_default();
+        scanner->display_switcher = 100;
+        scanner->display_prompt = (char *)_synctex_display_prompt + strlen(_synctex_display_prompt) - 1;
+    }
+    return scanner;
+}
+/*  Where the synctex scanner is created. */
+synctex_scanner_p synctex_scanner_new_with_output_file(const char *output, const char *build_directory, int parse)
+{
+    return synctex_scanner_new_with_options(output, build_directory, parse, NULL);
+}
+synctex_scanner_p synctex_scanner_new_with_options(const char *output, const char *build_directory, int parse, const synctex_parse_options_s *options)
+{
+    synctex_scanner_p scanner = synctex_scanner_new();
+    if (NULL == scanner) {
+        _synctex_error("malloc problem");
+        return NULL;
+    }
+    if (options) {
+        scanner->parse_int = synctex_parse_int_function((synctex_parse_int_policy_t)options->int_policy);
+        scanner->threads = options->threads;
+        scanner->flags.pipeline = options->pipeline != 0;
+    }
+    if (synctex_reader_init_with_output_file(scanner->reader, output, build_directory)) {
+        return parse ? synctex_scanner_parse(scanner) : scanner;
+    }
+    // don't warn to terminal if no file is present, this is a library.
+    // _synctex_error("No file?");
+    synctex_scanner_free(scanner);
+    return NULL;
+}
+
+static void _synctex_scanner_free_geometry(synctex_scanner_p scanner);
+
+/*  The scanner destructor
+ */
+int synctex_scanner_free(synctex_scanner_p scanner)
+{
+    int node_count = 0;
+    if (scanner) {
+#if SYNCTEX_USE_NODE_COUNT > 0
+        /*  Free the nodes one by one to track leaks. */
+        _synctex_node_free(scanner->sheet);
+        _synctex_node_free(scanner->form);
+#endif
+        /*  Input nodes own their name, the other nodes go away with their slabs. */
+        _synctex_node_free(scanner->input);
+        synctex_reader_free(scanner->reader);
+#if SYNCTEX_USE_NODE_COUNT > 0
+        SYNCTEX_SCANNER_FREE_HANDLE(scanner);
+#endif
+        synctex_iterator_free(scanner->iterator);
+        _synctex_scanner_free_geometry(scanner);
+        _synctex_scanner_free_slabs(scanner);
+        free(scanner->output_fmt);
+        free(scanner->sheet_by_page.nodes);
+        free(scanner->sheet_by_page.entries);
+        free(scanner->sheet_by_page.geometries);
+        free(scanner->form_by_tag.nodes);
+        free(scanner->input_by_tag.nodes);
+        free(scanner->names.entries);
+        free(scanner->friends.entries);
+        free(scanner->lines.entries);
+        free(scanner->proxies.entries);
+        free(scanner->form_lines.entries);
+        free(scanner->siblings.entries);
+        free(scanner->siblings.children);
+        free(scanner->deferred.entries);
+        free(scanner->sheets.entries);
+#if SYNCTEX_USE_NODE_COUNT > 0
+        node_count = scanner->node_count;
+#endif
+        free(scanner);
+    }
+    return node_count;
+}
+
+/*  Where the synctex scanner parses the contents of the file. */
+synctex_scanner_p synctex_scanner_parse(synctex_scanner_p scanner)
+{
+    synctex_status_t status = 0;
+    synctex_bool_t lazy = synctex_NO;
+    if (!scanner || scanner->flags.has_parsed) {
+        return scanner;
+    }
+    scanner->flags.has_parsed = 1;
+    lazy = scanner->flags.lazy;
+#if SYNCTEX_USE_THREADS
+    /*  The sheets are first located like in a lazy parse,
+     *  then parsed in parallel, from the whole content in memory. */
+    if (scanner->threads > 1 && _synctex_reader_load(scanner->reader)) {
+        scanner->flags.lazy = 1;
+    } else if (scanner->flags.pipeline) {
+        _synctex_reader_pipe(scanner->reader);
+    }
+#endif
+    scanner->pre_magnification = 1000;
+    scanner->pre_unit = 8192;
     scanner->pre_x_offset = scanner->pre_y_offset = 578;
     /*  initialize the offset with a fake improbable value,
      *  If there is a post scriptum section, this value will be overridden by the real life value */
@@ -6766,15 +9235,20 @@ synctex_scanner_p synctex_scanner_parse(synctex_scanner_p scanner)
     scanner->reader->line_number = 1;
 
     synctex_scanner_set_display_switcher(scanner, 1000);
-    SYNCTEX_END = SYNCTEX_START + SYNCTEX_BUFFER_SIZE;
-    /*  SYNCTEX_END always points to a null terminating character.
-     *  Maybe there is another null terminating character between SYNCTEX_CUR and SYNCTEX_END-1.
-     *  At least, we are sure that SYNCTEX_CUR points to a string covering a valid part of the memory. */
-    *SYNCTEX_END = '\0';
-    SYNCTEX_CUR = SYNCTEX_END;
+    if (scanner->reader->mapped) {
+        /*  The whole file is available, SYNCTEX_END already points to a null terminating character. */
+        SYNCTEX_CUR = SYNCTEX_START;
+    } else {
+        SYNCTEX_END = SYNCTEX_START + SYNCTEX_BUFFER_SIZE;
+        /*  SYNCTEX_END always points to a null terminating character.
+         *  Maybe there is another null terminating character between SYNCTEX_CUR and SYNCTEX_END-1.
+         *  At least, we are sure that SYNCTEX_CUR points to a string covering a valid part of the memory. */
+        *SYNCTEX_END = '\0';
+        SYNCTEX_CUR = SYNCTEX_END;
 #if defined(SYNCTEX_USE_CHARINDEX)
-    scanner->reader->charindex_offset = -SYNCTEX_BUFFER_SIZE;
+        scanner->reader->charindex_offset = -SYNCTEX_BUFFER_SIZE;
 #endif
+    }
     status = _synctex_scan_preamble(scanner);
     if (status < SYNCTEX_STATUS_OK) {
         _synctex_error("Bad preamble\n");
@@ -6795,11 +9269,16 @@ synctex_scanner_p synctex_scanner_parse(synctex_scanner_p scanner)
     synctex_node_display(scanner->form);
 #endif
     synctex_scanner_set_display_switcher(scanner, 1000);
-    /*  Everything is finished, free the buffer, close the file */
-    free((void *)SYNCTEX_START);
-    SYNCTEX_START = SYNCTEX_CUR = SYNCTEX_END = NULL;
-    gzclose(SYNCTEX_FILE);
-    SYNCTEX_FILE = NULL;
+    if (!lazy) {
+        _synctex_scanner_parse_sheets(scanner);
+        scanner->flags.lazy = 0;
+    }
+    /*  Everything is finished, free the buffer or unmap the file, close the file,
+     *  unless some sheets remain to be parsed. */
+    if (0 == scanner->sheets.pending) {
+        _synctex_reader_free_buffer(scanner->reader);
+        _synctex_reader_close(scanner->reader);
+    }
     /*  Final tuning: set the default values for various parameters */
     /*  1 pre_unit = (scanner->pre_unit)/65536 pt = (scanner->pre_unit)/65781.76 bp
      * 1 pt = 65536 sp */
@@ -6836,8 +9315,61 @@ return_on_error:
         return NULL;
 #endif
 }
+/*  Where the synctex scanner parses the contents of the file lazily. */
+synctex_scanner_p synctex_scanner_parse_lazily(synctex_scanner_p scanner)
+{
+    if (!scanner || scanner->flags.has_parsed) {
+        return scanner;
+    }
+    scanner->flags.lazy = 1;
+    return synctex_scanner_parse(scanner);
+}
+static synctex_bool_t _synctex_scanner_index_names(synctex_scanner_p scanner);
+static _synctex_geometry_p _synctex_scanner_geometry(synctex_scanner_p scanner, synctex_node_p sheet);
+/*  Create the child proxies of all the proxies in the given trees and their siblings.
+ *  synctex_node_child creates the child proxies of a proxy on demand,
+ *  visit all the nodes such that it is called on each one.
+ */
+static void _synctex_trees_create_child_proxies(synctex_node_p node)
+{
+    while (node) {
+        synctex_node_child(node);
+        node = synctex_node_next(node);
+    }
+}
+/*  Do all the work that queries would do on demand,
+ *  such that they only read the scanner and its nodes afterwards. */
+synctex_scanner_p synctex_scanner_freeze(synctex_scanner_p scanner)
+{
+    synctex_node_p node = NULL;
+    if (NULL == (scanner = synctex_scanner_parse(scanner)) || scanner->flags.frozen) {
+        return scanner;
+    }
+    _synctex_scanner_parse_sheets(scanner);
+    if (scanner->proxies.count) {
+        _synctex_scanner_sort_proxies(scanner);
+        _synctex_scanner_register_proxies(scanner, 0, scanner->proxies.count);
+    }
+    /*  Create the remaining child proxies */
+    _synctex_trees_create_child_proxies(scanner->form);
+    _synctex_trees_create_child_proxies(scanner->sheet);
+    if (!_synctex_scanner_index_names(scanner) || !_synctex_scanner_index_lines(scanner)) {
+        _synctex_error("!  synctex_scanner_freeze: malloc problem.");
+        goto return_on_error;
+    }
+    for (node = scanner->sheet; node; node = __synctex_tree_sibling(node)) {
+        if (NULL == _synctex_scanner_geometry(scanner, node)) {
+            goto return_on_error;
+        }
+    }
+    scanner->flags.frozen = 1;
+    return scanner;
 
-#undef SYNCTEX_FILE
+return_on_error:
+    /*  Like synctex_scanner_parse, the caller never has to free the scanner on failure */
+    synctex_scanner_free(scanner);
+    return NULL;
+}
 
 /*  Scanner accessors.
  */
@@ -6871,16 +9403,18 @@ void synctex_scanner_display(synctex_scanner_p scanner)
     printf("count:%i\npost_magnification:%f\npost_x_offset:%f\npost_y_offset:%f\n", scanner->count, scanner->unit, scanner->x_offset, scanner->y_offset);
     printf("The input:\n");
     synctex_node_display(scanner->input);
+    _synctex_scanner_parse_sheets(scanner);
     if (scanner->count < 1000) {
         printf("The sheets:\n");
         synctex_node_display(scanner->sheet);
         printf("The friends:\n");
-        if (scanner->lists_of_friends) {
-            int i = scanner->number_of_lists;
+        if (scanner->friends.entries) {
+            int i = scanner->friends.capacity;
             synctex_node_p node;
             while (i--) {
-                printf("Friend index:%i\n", i);
-                node = (scanner->lists_of_friends)[i];
+                if ((node = scanner->friends.entries[i].node)) {
+                    printf("Friend index:%i,%i\n", scanner->friends.entries[i].tag, scanner->friends.entries[i].line);
+                }
                 while (node) {
                     printf("%s:%i,%i\n", synctex_node_isa(node), _synctex_data_tag(node), _synctex_data_line(node));
                     node = _synctex_tree_friend(node);
@@ -6906,13 +9440,8 @@ const char *synctex_scanner_get_name(synctex_scanner_p scanner, int tag)
     if (NULL == scanner) {
         return NULL;
     }
-    if ((input = scanner->input)) {
-        ;
-        do {
-            if (tag == _synctex_data_tag(input)) {
-                return (_synctex_data_name(input));
-            }
-        } while ((input = __synctex_tree_sibling(input)));
+    if ((input = synctex_scanner_input_with_tag(scanner, tag))) {
+        return _synctex_data_name(input);
     }
     return NULL;
 }
@@ -6932,37 +9461,93 @@ const char *synctex_node_get_name(synctex_node_p node)
     return NULL;
 }
 
-static int _synctex_scanner_get_tag(synctex_scanner_p scanner, const char *name);
-static int _synctex_scanner_get_tag(synctex_scanner_p scanner, const char *name)
+/*  The entry of the name index with the given name or base name,
+ *  or the empty entry where it should be inserted.
+ */
+static _synctex_name_entry_s *_synctex_scanner_name_entry(synctex_scanner_p scanner, const char *name, unsigned int hash, synctex_bool_t base)
+{
+    unsigned int mask = (unsigned int)scanner->names.capacity - 1;
+    unsigned int i = hash & mask;
+    _synctex_name_entry_s *entry = scanner->names.entries + i;
+    while (entry->input) {
+        if (entry->hash == hash && entry->base == base) {
+            const char *other = _synctex_data_name(entry->input);
+            if (_synctex_is_equivalent_file_name(name, base ? _synctex_base_name(other) : other)) {
+                return entry;
+            }
+        }
+        i = (i + 1) & mask;
+        entry = scanner->names.entries + i;
+    }
+    return entry;
+}
+/*  Build the name index, again when inputs were added since last time.
+ *  - returns: yorn, no on allocation failure.
+ */
+static synctex_bool_t _synctex_scanner_index_names(synctex_scanner_p scanner)
 {
     synctex_node_p input = NULL;
+    int count = 0;
+    int capacity = 16;
+    if (scanner->names.entries && scanner->names.input == scanner->input) {
+        return synctex_YES;
+    }
+    for (input = scanner->input; input; input = __synctex_tree_sibling(input)) {
+        ++count;
+    }
+    /*  2 entries per input, the load factor is at most 1/2 */
+    while (capacity < 4 * count) {
+        capacity *= 2;
+    }
+    free(scanner->names.entries);
+    if (NULL == (scanner->names.entries = _synctex_malloc(capacity * sizeof(_synctex_name_entry_s)))) {
+        scanner->names.capacity = 0;
+        return synctex_NO;
+    }
+    scanner->names.capacity = capacity;
+    scanner->names.input = scanner->input;
+    for (input = scanner->input; input; input = __synctex_tree_sibling(input)) {
+        const char *name = _synctex_data_name(input);
+        unsigned int hash = _synctex_file_name_hash(name);
+        _synctex_name_entry_s *entry = _synctex_scanner_name_entry(scanner, name, hash, synctex_NO);
+        if (NULL == entry->input) {
+            *entry = (_synctex_name_entry_s){hash, synctex_NO, synctex_NO, input};
+        }
+        /*  2011 version */
+        name = _synctex_base_name(name);
+        hash = _synctex_file_name_hash(name);
+        entry = _synctex_scanner_name_entry(scanner, name, hash, synctex_YES);
+        if (NULL == entry->input) {
+            *entry = (_synctex_name_entry_s){hash, synctex_YES, synctex_NO, input};
+        } else if (strcmp(_synctex_data_name(entry->input), _synctex_data_name(input))) {
+            /*  There is a second possible candidate */
+            entry->ambiguous = synctex_YES;
+        }
+    }
+    return synctex_YES;
+}
+/*  The tag of the first input with an equivalent name,
+ *  or else of the first input with an equivalent base name,
+ *  unless a following input has the same base name but another name.
+ *  - returns: the tag, 0 if none.
+ */
+static int _synctex_scanner_get_tag(synctex_scanner_p scanner, const char *name)
+{
+    _synctex_name_entry_s *entry = NULL;
     if (NULL == scanner) {
         return 0;
     }
-    if ((input = scanner->input)) {
-        do {
-            if (_synctex_is_equivalent_file_name(name, (_synctex_data_name(input)))) {
-                return _synctex_data_tag(input);
-            }
-        } while ((input = __synctex_tree_sibling(input)));
+    if (!_synctex_scanner_index_names(scanner)) {
+        _synctex_error("!  _synctex_scanner_get_tag: malloc problem.");
+        return 0;
+    }
+    if ((entry = _synctex_scanner_name_entry(scanner, name, _synctex_file_name_hash(name), synctex_NO))->input) {
+        return _synctex_data_tag(entry->input);
     }
     //  2011 version
     name = _synctex_base_name(name);
-    if ((input = scanner->input)) {
-        do {
-            if (_synctex_is_equivalent_file_name(name, _synctex_base_name(_synctex_data_name(input)))) {
-                synctex_node_p other_input = input;
-                while ((other_input = __synctex_tree_sibling(other_input))) {
-                    if (_synctex_is_equivalent_file_name(name, _synctex_base_name(_synctex_data_name(other_input)))
-                        && (strlen(_synctex_data_name(input)) != strlen(_synctex_data_name(other_input))
-                            || strncmp(_synctex_data_name(other_input), _synctex_data_name(input), strlen(_synctex_data_name(input))))) {
-                        // There is a second possible candidate
-                        return 0;
-                    }
-                }
-                return _synctex_data_tag(input);
-            }
-        } while ((input = __synctex_tree_sibling(input)));
+    if ((entry = _synctex_scanner_name_entry(scanner, name, _synctex_file_name_hash(name), synctex_YES))->input) {
+        return entry->ambiguous ? 0 : _synctex_data_tag(entry->input);
     }
     return 0;
 }
@@ -6990,7 +9575,7 @@ int synctex_scanner_get_tag(synctex_scanner_p scanner, const char *name)
                  *  try a name relative to the enclosing directory of the scanner->output file */
                 const char *relative = name;
                 const char *ptr = scanner->reader->output;
-                while ((strlen(relative) > 0) && (strlen(ptr) > 0) && (*relative == *ptr)) {
+                while (*relative && *ptr && (*relative == *ptr)) {
                     relative += 1;
                     ptr += 1;
                 }
@@ -7025,9 +9610,12 @@ synctex_node_p synctex_scanner_input(synctex_scanner_p scanner)
     return scanner ? scanner->input : NULL;
 }
 synctex_node_p synctex_scanner_input_with_tag(synctex_scanner_p scanner, int tag) {
-    synctex_node_p input = scanner?scanner->input:NULL;
-    while (input && _synctex_data_tag(input)!=tag) {
-        input = __synctex_tree_sibling(input);
+    synctex_node_p input = NULL;
+    if (scanner && NULL == (input = _synctex_directory_get(&scanner->input_by_tag, tag)) && scanner->input_by_tag.sparse) {
+        input = scanner->input;
+        while (input && _synctex_data_tag(input)!=tag) {
+            input = __synctex_tree_sibling(input);
+        }
     }
     return input;
 }
@@ -7225,9 +9813,9 @@ int synctex_node_hbox_h(synctex_node_p node)
 {
     switch (synctex_node_type(node)) {
     case synctex_node_type_hbox:
-        return _synctex_data_h_V(node);
+        return SYNCTEX_FIXED(node, hbox, h_V);
     case synctex_node_type_proxy_hbox:
-        return _synctex_data_h(node) + synctex_node_hbox_h(_synctex_tree_target(node));
+        return SYNCTEX_FIXED(node, proxy_hbox, proxy_h) + synctex_node_hbox_h(_synctex_tree_target(node));
     default:
         return 0;
     }
@@ -7243,9 +9831,9 @@ int synctex_node_hbox_v(synctex_node_p node)
 {
     switch (synctex_node_type(node)) {
     case synctex_node_type_hbox:
-        return _synctex_data_v_V(node);
+        return SYNCTEX_FIXED(node, hbox, v_V);
     case synctex_node_type_proxy_hbox:
-        return _synctex_data_v(node) + synctex_node_hbox_v(_synctex_tree_target(node));
+        return SYNCTEX_FIXED(node, proxy_hbox, proxy_v) + synctex_node_hbox_v(_synctex_tree_target(node));
     default:
         return 0;
     }
@@ -7262,7 +9850,7 @@ int synctex_node_hbox_width(synctex_node_p node)
     if (target) {
         node = target;
     }
-    return synctex_node_type(node) == synctex_node_type_hbox ? _synctex_data_width_V(node) : 0;
+    return synctex_node_type(node) == synctex_node_type_hbox ? SYNCTEX_FIXED(node, hbox, width_V) : 0;
 }
 /**
  *  The height of an hbox, corrected with contents.
@@ -7276,7 +9864,7 @@ int synctex_node_hbox_height(synctex_node_p node)
     if (target) {
         node = target;
     }
-    return synctex_node_type(node) == synctex_node_type_hbox ? _synctex_data_height_V(node) : 0;
+    return synctex_node_type(node) == synctex_node_type_hbox ? SYNCTEX_FIXED(node, hbox, height_V) : 0;
 }
 /**
  *  The depth of an hbox, corrected with contents.
@@ -7291,7 +9879,7 @@ int synctex_node_hbox_depth(synctex_node_p node)
     if (target) {
         node = target;
     }
-    return synctex_node_type(node) == synctex_node_type_hbox ? _synctex_data_depth_V(node) : 0;
+    return synctex_node_type(node) == synctex_node_type_hbox ? SYNCTEX_FIXED(node, hbox, depth_V) : 0;
 }
 #ifdef SYNCTEX_NOTHING
 #pragma mark -
@@ -7645,11 +10233,16 @@ float synctex_node_box_visible_depth(synctex_node_p node)
  *      but a form, its page number is always -1.
  *  - note: a handles does not belong to a sheet not a form.
  *      its page number is -1.
+ *  - note: the page is recorded in the node when it is attached
+ *      to its parent at parse time, the tree is only climbed otherwise.
  *  - author: JL
  */
 int synctex_node_page(synctex_node_p node)
 {
     synctex_node_p parent = NULL;
+    if (node && node->page) {
+        return node->page;
+    }
     while ((parent = _synctex_tree_parent(node))) {
         node = parent;
     }
@@ -7773,14 +10366,24 @@ int synctex_node_child_count(synctex_node_p node)
 synctex_node_p synctex_sheet(synctex_scanner_p scanner, int page)
 {
     if (scanner) {
-        synctex_node_p sheet = scanner->sheet;
-        while (sheet) {
-            if (page == _synctex_data_page(sheet)) {
-                return sheet;
+        synctex_node_p sheet = _synctex_directory_get(&scanner->sheet_by_page, page);
+        int entry = sheet ? _synctex_directory_get_entry(&scanner->sheet_by_page, page) : -2;
+        if (NULL == sheet && scanner->sheet_by_page.sparse) {
+            sheet = scanner->sheet;
+            while (sheet && page != _synctex_data_page(sheet)) {
+                sheet = __synctex_tree_sibling(sheet);
             }
-            sheet = __synctex_tree_sibling(sheet);
+        }
+        if (sheet) {
+            if (scanner->sheets.pending) {
+                /*  The entry is not known for pages too sparse for the directory */
+                _synctex_scanner_parse_sheet(scanner, entry > -2 ? entry : _synctex_scanner_sheet_entry(scanner, sheet));
+            }
+            return sheet;
         }
         if (page == 0) {
+            /*  The caller will certainly browse all the sheets */
+            _synctex_scanner_parse_sheets(scanner);
             return scanner->sheet;
         }
     }
@@ -7797,12 +10400,15 @@ synctex_node_p synctex_sheet(synctex_scanner_p scanner, int page)
 synctex_node_p synctex_form(synctex_scanner_p scanner, int tag)
 {
     if (scanner) {
-        synctex_node_p form = scanner->form;
-        while (form) {
-            if (tag == _synctex_data_tag(form)) {
-                return form;
+        synctex_node_p form = _synctex_directory_get(&scanner->form_by_tag, tag);
+        if (NULL == form && scanner->form_by_tag.sparse) {
+            form = scanner->form;
+            while (form && tag != _synctex_data_tag(form)) {
+                form = __synctex_tree_sibling(form);
             }
-            form = __synctex_tree_sibling(form);
+        }
+        if (form) {
+            return form;
         }
         if (tag == 0) {
             return scanner->form;
@@ -7841,14 +10447,6 @@ synctex_node_p synctex_form_content(synctex_scanner_p scanner, int tag)
     return NULL;
 }
 
-static SYNCTEX_INLINE synctex_node_p _synctex_scanner_friend(synctex_scanner_p scanner, int i)
-{
-    if (i >= 0) {
-        i = _synctex_abs(i) % (scanner->number_of_lists);
-        return (scanner->lists_of_friends)[i];
-    }
-    return NULL;
-}
 static SYNCTEX_INLINE synctex_bool_t _synctex_nodes_are_friend(synctex_node_p left, synctex_node_p right)
 {
     return synctex_node_tag(left) == synctex_node_tag(right) && synctex_node_line(left) == synctex_node_line(right);
@@ -7861,38 +10459,97 @@ typedef struct {
     synctex_node_p node;
 } _synctex_counted_node_s;
 
+/*  A node with an index, in a list or in a geometry store */
+typedef struct {
+    synctex_node_p node;
+    int index;
+} _synctex_node_index_s;
+
+/*  The number of friends of the node among its siblings,
+ *  counted at parse time, through the target for child proxies.
+ */
+static SYNCTEX_INLINE int _synctex_node_friends(synctex_node_p node)
+{
+    synctex_node_p target = NULL;
+    while (0 == node->friends && (target = _synctex_tree_target(node))) {
+        node = target;
+    }
+    return node->friends;
+}
+static int _synctex_handle_parent_cmp(const void *a, const void *b)
+{
+    const _synctex_node_index_s *l = a;
+    const _synctex_node_index_s *r = b;
+    if (l->node != r->node) {
+        return l->node->index < r->node->index ? -1 : 1;
+    }
+    return l->index < r->index ? -1 : l->index > r->index;
+}
 static SYNCTEX_INLINE _synctex_counted_node_s _synctex_vertically_sorted_v2(synctex_node_p sibling)
 {
-    /* Clean the weights of the parents */
+    /*  The weight of a handle is the number of friends of its target
+     *  among the children of their parent, counted at parse time.
+     *  Only the first handle with a given hbox parent has a weight,
+     *  the next ones are freed below.
+     *  The nodes are not modified, only the handles. */
     _synctex_counted_node_s result = {0, NULL};
+    _synctex_node_index_s *parents = NULL;
     synctex_node_p h = NULL;
     synctex_node_p next_h = NULL;
     synctex_node_p parent = NULL;
     int weight = 0;
+    int count = 0;
+    int i;
     synctex_node_p N = NULL;
     h = sibling;
     do {
-        N = _synctex_tree_target(h);
-        parent = _synctex_tree_parent(N);
-        _synctex_data_set_weight(parent, 0);
+        ++count;
     } while ((h = _synctex_tree_child(h)));
-    /* Compute the weights of the nodes */
-    h = sibling;
-    do {
+    if (count > 1 && (parents = _synctex_malloc(count * sizeof(_synctex_node_index_s)))) {
+        /*  The hbox parents, by chain order within the same parent */
+        h = sibling;
+        count = 0;
+        i = 0;
+        do {
+            parent = _synctex_tree_parent(_synctex_tree_target(h));
+            if (synctex_node_type(parent) == synctex_node_type_hbox) {
+                parents[count++] = (_synctex_node_index_s){parent, i};
+            }
+            ++i;
+        } while ((h = _synctex_tree_child(h)));
+        qsort(parents, count, sizeof(_synctex_node_index_s), &_synctex_handle_parent_cmp);
+    } else {
+        count = 0;
+    }
+    /* Compute the weights of the handles */
+    h = sibling;
+    i = 0;
+    do {
         N = _synctex_tree_target(h);
         parent = _synctex_tree_parent(N);
-        weight = _synctex_data_weight(parent);
-        if (weight == 0) {
+        if (count && synctex_node_type(parent) == synctex_node_type_hbox) {
+            _synctex_node_index_s key = {parent, i};
+            _synctex_node_index_s *found = bsearch(&key, parents, count, sizeof(_synctex_node_index_s), &_synctex_handle_parent_cmp);
+            if (found > parents && found[-1].node == parent) {
+                /*  Not the first handle with this parent */
+                ++i;
+                continue;
+            }
+        }
+        weight = _synctex_nodes_are_friend(N, sibling) ? _synctex_node_friends(N) : 0;
+        if (0 == weight && parent) {
+            /*  Not counted at parse time, or for another tag and line */
             N = _synctex_tree_child(parent);
             do {
                 if (_synctex_nodes_are_friend(N, sibling)) {
                     ++weight;
                 }
             } while ((N = __synctex_tree_sibling(N)));
-            _synctex_data_set_weight(h, weight);
-            _synctex_data_set_weight(parent, weight);
         }
+        _synctex_data_set_weight(h, weight);
+        ++i;
     } while ((h = _synctex_tree_child(h)));
+    _synctex_free(parents);
     /* Order handle nodes according to the weight */
     h = _synctex_tree_reset_child(sibling);
     result.node = sibling;
@@ -7993,6 +10650,83 @@ static int _synctex_point_node_distance_v2(synctex_point_p hitP, synctex_node_p
  *  The "visible" version takes into account the visible dimensions instead of the real ones given by TeX. */
 static _synctex_nd_s _synctex_eq_closest_child_v2(synctex_point_p hitP, synctex_node_p node);
 
+/**
+ *  A packed R-tree, built once by _synctex_rtree_build.
+ */
+typedef struct {
+    /** The bounds of the nodes, the leaves first and the root last */
+    synctex_box_s *box;
+    /** For a leaf, the item it stands for,
+     *  for another node, the index of its first child */
+    int *index;
+    /** The index of the first node of each level, then the number of nodes */
+    int level[SYNCTEX_RTREE_MAX_LEVEL + 1];
+    /** The number of levels, 0 when there is no leaf */
+    int levels;
+} _synctex_rtree_s;
+
+/**
+ *  The geometry of the nodes of a sheet, as columns in preorder.
+ *  It is built on the first edit query on the sheet,
+ *  hit testing then runs as linear scans over integer arrays
+ *  that skip whole subtrees.
+ *  Proxies are resolved: h and v are absolute and shape is the type of the proxied node.
+ *  The height and depth of a leaf are the ones of its parent, as used for hit testing.
+ */
+typedef struct _synctex_geometry_t {
+    /** The store of the next sheet that was queried */
+    _synctex_geometry_p next;
+    /** The sheet, at index 0 */
+    synctex_node_p sheet;
+    /** The number of nodes, the sheet included */
+    int count;
+    /** The columns */
+    int *type;
+    int *shape;
+    int *tag;
+    int *line;
+    int *h;
+    int *v;
+    int *width;
+    int *height;
+    int *depth;
+    /** The index following the subtree of each node */
+    int *end;
+    /** The nodes */
+    synctex_node_p *node;
+    /** The horizontal boxes, in the next_hbox order of the sheet */
+    int *hbox;
+    /** The number of horizontal boxes */
+    int hbox_count;
+    /** The spatial index of the horizontal boxes, leaves are positions in hbox */
+    _synctex_rtree_s hbox_tree;
+    /** The spatial index of the nodes that are not boxes,
+     *  leaves are indices of nodes with a finite distance to any point */
+    _synctex_rtree_s leaf_tree;
+} _synctex_geometry_s;
+
+static _synctex_geometry_p _synctex_scanner_geometry(synctex_scanner_p scanner, synctex_node_p sheet);
+static SYNCTEX_INLINE synctex_bool_t _synctex_geometry_in_box(_synctex_geometry_p geometry, int i, synctex_point_p hitP);
+static int _synctex_geometry_deepest_container(_synctex_geometry_p geometry, synctex_point_p hitP, int i);
+static int _synctex_geometry_hbox_containing(_synctex_geometry_p geometry, synctex_point_p hitP, int **found);
+static _synctex_nd_s _synctex_geometry_closest_deep_child(_synctex_geometry_p geometry, synctex_point_p hitP, int i);
+static int _synctex_geometry_nearest_leaves(_synctex_geometry_p geometry, synctex_point_p hitP, int k, int *found);
+
+/*  A source location found in a region, at index in the geometry store */
+typedef struct {
+    int line;
+    int tag;
+    int index;
+} _synctex_location_s;
+
+typedef struct {
+    _synctex_location_s *location;
+    int count;
+    int capacity;
+} _synctex_locations_s;
+
+static int _synctex_geometry_region(_synctex_geometry_p geometry, synctex_box_p region, int i, _synctex_locations_s *locations);
+
 #ifdef SYNCTEX_NOTHING
 #pragma mark -
 #pragma mark Queries
@@ -8007,17 +10741,29 @@ typedef struct synctex_iterator_t {
     synctex_node_p next;
     int count0;
     int count;
+    /*  One rectangle for each result of a display range query, NULL otherwise */
+    synctex_rect_p rects;
+    /*  The scanner owning the handles, NULL when it is the one of their targets */
+    synctex_scanner_p results;
 } synctex_iterator_s;
 /**
  * @endcond
  */
 
-static SYNCTEX_INLINE synctex_iterator_p _synctex_iterator_new(synctex_node_p result, int count)
+/*  An iterator over the given handles allocated by results for a query to scanner.
+ *  On allocation failure, the handles are released.
+ */
+static SYNCTEX_INLINE synctex_iterator_p _synctex_iterator_new(synctex_scanner_p scanner, synctex_scanner_p results, synctex_node_p result, int count)
 {
     synctex_iterator_p iterator;
     if ((iterator = _synctex_malloc(sizeof(synctex_iterator_s)))) {
         iterator->seed = iterator->top = iterator->next = result;
         iterator->count0 = iterator->count = count;
+        iterator->results = results == scanner ? NULL : results;
+    } else if (results == scanner) {
+        _synctex_node_free(result);
+    } else {
+        _synctex_scanner_free_results(scanner, results);
     }
     return iterator;
 }
@@ -8025,7 +10771,12 @@ static SYNCTEX_INLINE synctex_iterator_p _synctex_iterator_new(synctex_node_p re
 void synctex_iterator_free(synctex_iterator_p iterator)
 {
     if (iterator) {
-        _synctex_node_free(iterator->seed);
+        if (iterator->results) {
+            _synctex_scanner_free_results(NULL, iterator->results);
+        } else {
+            _synctex_node_free(iterator->seed);
+        }
+        _synctex_free(iterator->rects);
         _synctex_free(iterator);
     }
 }
@@ -8056,6 +10807,15 @@ synctex_node_p synctex_iterator_next_result(synctex_iterator_p iterator)
     }
     return NULL;
 }
+synctex_bool_t synctex_iterator_next_rect(synctex_iterator_p iterator, synctex_rect_p rect)
+{
+    if (iterator && iterator->rects && iterator->count > 0) {
+        *rect = iterator->rects[iterator->count0 - iterator->count];
+        synctex_iterator_next_result(iterator);
+        return synctex_YES;
+    }
+    return synctex_NO;
+}
 int synctex_iterator_reset(synctex_iterator_p iterator)
 {
     if (iterator) {
@@ -8064,104 +10824,154 @@ int synctex_iterator_reset(synctex_iterator_p iterator)
     }
     return 0;
 }
+/*  An iterator over handles to the nodes of the geometry store at the given indices.
+ *  - returns: NULL when there is no index or on allocation failure.
+ */
+static synctex_iterator_p _synctex_iterator_new_with_geometry(synctex_scanner_p scanner, _synctex_geometry_p geometry, int *indices, int count)
+{
+    synctex_scanner_p results = NULL;
+    synctex_node_p first = NULL;
+    synctex_node_p last = NULL;
+    int j;
+    if (0 == count || NULL == (results = _synctex_scanner_new_results(scanner))) {
+        return NULL;
+    }
+    for (j = 0; j < count; ++j) {
+        synctex_node_p handle = _synctex_new_result(results, geometry->node[indices[j]]);
+        if (NULL == handle) {
+            _synctex_node_free(first);
+            _synctex_scanner_free_results(scanner, results);
+            return NULL;
+        }
+        if (last) {
+            _synctex_tree_set_sibling(last, handle);
+        } else {
+            first = handle;
+        }
+        last = handle;
+    }
+    return _synctex_iterator_new(scanner, results, first, count);
+}
 
 synctex_iterator_p synctex_iterator_new_edit(synctex_scanner_p scanner, int page, float h, float v)
 {
     if (scanner) {
         synctex_node_p sheet = NULL;
+        _synctex_geometry_p geometry = NULL;
         synctex_point_s hit;
         synctex_node_p node = NULL;
+        synctex_scanner_p results = NULL;
         _synctex_nd_lr_s nds = {{NULL, 0}, {NULL, 0}};
+        int buffer[SYNCTEX_RTREE_FOUND_MAX];
+        int *found = buffer;
+        int count, k;
         if (NULL == (scanner = synctex_scanner_parse(scanner)) || 0 >= scanner->unit) { /*  scanner->unit must be >0 */
             return NULL;
         }
         /*  Find the proper sheet */
         sheet = synctex_sheet(scanner, page);
-        if (NULL == sheet) {
+        if (NULL == sheet || NULL == (geometry = _synctex_scanner_geometry(scanner, sheet))) {
             return NULL;
         }
         /*  Now sheet points to the sheet node with proper page number. */
         /*  Now that scanner has been initialized, we can convert
          *  the given point to scanner integer coordinates */
         hit = (synctex_point_s){(h - scanner->x_offset) / scanner->unit, (v - scanner->y_offset) / scanner->unit};
-        /*  At first, we browse all the horizontal boxes of the sheet
-         *  until we find one containing the hit point. */
-        if ((node = _synctex_tree_next_hbox(sheet))) {
-            do {
-                if (_synctex_point_in_box_v2(&hit, node)) {
-                    /*  Maybe the hit point belongs to a contained vertical box.
-                     *  This is the most likely situation.
-                     */
-                    synctex_node_p next = node;
+        /*  At first, we look for the horizontal boxes of the sheet
+         *  containing the hit point, in the next_hbox order. */
+        if ((count = _synctex_geometry_hbox_containing(geometry, &hit, &found)) < 0) {
+            _synctex_error("!  synctex_iterator_new_edit: malloc problem.");
+            return NULL;
+        }
+        if (count > 0) {
+            int i = geometry->hbox[found[0]];
+            /*  Maybe the hit point belongs to a contained vertical box.
+             *  This is the most likely situation.
+             */
+            node = geometry->node[i];
 #if defined(SYNCTEX_DEBUG)
-                    printf("--- We are lucky\n");
-#endif
-                    /*  This trick is for catching overlapping boxes */
-                    while ((next = _synctex_tree_next_hbox(next))) {
-                        if (_synctex_point_in_box_v2(&hit, next)) {
-                            node = _synctex_smallest_container_v2(next, node);
-                        }
-                    }
-                    /*  node is the smallest horizontal box that contains hit,
-                     *  unless there is no hbox at all.
-                     */
-                    node = _synctex_eq_deepest_container_v2(&hit, node);
-                    nds = _synctex_eq_get_closest_children_in_box_v2(&hit, node);
-                end:
-                    if (nds.r.node && nds.l.node) {
-                        if ((_synctex_data_tag(nds.r.node) != _synctex_data_tag(nds.l.node))
-                            || (_synctex_data_line(nds.r.node) != _synctex_data_line(nds.l.node))
-                            || (_synctex_data_column(nds.r.node) != _synctex_data_column(nds.l.node))) {
-                            if (_synctex_data_line(nds.r.node) < _synctex_data_line(nds.l.node)) {
-                                node = nds.r.node;
-                                nds.r.node = nds.l.node;
-                                nds.l.node = node;
-                            } else if (_synctex_data_line(nds.r.node) == _synctex_data_line(nds.l.node)) {
-                                if (nds.l.distance > nds.r.distance) {
-                                    node = nds.r.node;
-                                    nds.r.node = nds.l.node;
-                                    nds.l.node = node;
-                                }
-                            }
-                            if ((node = _synctex_new_handle_with_target(nds.l.node))) {
-                                synctex_node_p other_handle;
-                                if ((other_handle = _synctex_new_handle_with_target(nds.r.node))) {
-                                    _synctex_tree_set_sibling(node, other_handle);
-                                    return _synctex_iterator_new(node, 2);
-                                }
-                                return _synctex_iterator_new(node, 1);
-                            }
-                            return NULL;
-                        }
-                        /*  both nodes have the same input coordinates
-                         *  We choose the one closest to the hit point  */
+            printf("--- We are lucky\n");
+#endif
+            /*  This trick is for catching overlapping boxes */
+            for (k = 1; k < count; ++k) {
+                int j = geometry->hbox[found[k]];
+                node = _synctex_smallest_container_v2(geometry->node[j], node);
+                if (node == geometry->node[j]) {
+                    i = j;
+                }
+            }
+            if (found != buffer) {
+                _synctex_free(found);
+            }
+            /*  node is the smallest horizontal box that contains hit,
+             *  unless there is no hbox at all.
+             */
+            i = _synctex_geometry_deepest_container(geometry, &hit, i);
+            node = i < 0 ? NULL : geometry->node[i];
+            nds = _synctex_eq_get_closest_children_in_box_v2(&hit, node);
+        end:
+            if (nds.r.node && nds.l.node) {
+                if ((_synctex_data_tag(nds.r.node) != _synctex_data_tag(nds.l.node))
+                    || (_synctex_data_line(nds.r.node) != _synctex_data_line(nds.l.node))
+                    || (_synctex_data_column(nds.r.node) != _synctex_data_column(nds.l.node))) {
+                    if (_synctex_data_line(nds.r.node) < _synctex_data_line(nds.l.node)) {
+                        node = nds.r.node;
+                        nds.r.node = nds.l.node;
+                        nds.l.node = node;
+                    } else if (_synctex_data_line(nds.r.node) == _synctex_data_line(nds.l.node)) {
                         if (nds.l.distance > nds.r.distance) {
-                            nds.l.node = nds.r.node;
+                            node = nds.r.node;
+                            nds.r.node = nds.l.node;
+                            nds.l.node = node;
                         }
-                        nds.r.node = NULL;
-                    } else if (nds.r.node) {
-                        nds.l = nds.r;
-                    } else if (!nds.l.node) {
-                        nds.l.node = node;
                     }
-                    if ((node = _synctex_new_handle_with_target(nds.l.node))) {
-                        return _synctex_iterator_new(node, 1);
+                    if (NULL == (results = _synctex_scanner_new_results(scanner))) {
+                        return NULL;
+                    }
+                    if ((node = _synctex_new_result(results, nds.l.node))) {
+                        synctex_node_p other_handle;
+                        if ((other_handle = _synctex_new_result(results, nds.r.node))) {
+                            _synctex_tree_set_sibling(node, other_handle);
+                            return _synctex_iterator_new(scanner, results, node, 2);
+                        }
+                        return _synctex_iterator_new(scanner, results, node, 1);
                     }
-                    return 0;
+                    _synctex_scanner_free_results(scanner, results);
+                    return NULL;
                 }
-            } while ((node = _synctex_tree_next_hbox(node)));
-            /*  All the horizontal boxes have been tested,
-             *  None of them contains the hit point.
-             */
+                /*  both nodes have the same input coordinates
+                 *  We choose the one closest to the hit point  */
+                if (nds.l.distance > nds.r.distance) {
+                    nds.l.node = nds.r.node;
+                }
+                nds.r.node = NULL;
+            } else if (nds.r.node) {
+                nds.l = nds.r;
+            } else if (!nds.l.node) {
+                nds.l.node = node;
+            }
+            if (NULL == (results = _synctex_scanner_new_results(scanner))) {
+                return NULL;
+            }
+            if ((node = _synctex_new_result(results, nds.l.node))) {
+                return _synctex_iterator_new(scanner, results, node, 1);
+            }
+            _synctex_scanner_free_results(scanner, results);
+            return 0;
         }
+        /*  All the horizontal boxes have been tested,
+         *  None of them contains the hit point.
+         */
         /*  We are not lucky,
          *  we test absolutely all the node
          *  to find the closest... */
-        if ((node = _synctex_tree_child(sheet))) {
+        if (geometry->count > 1) {
 #if defined(SYNCTEX_DEBUG)
             printf("--- We are not lucky\n");
 #endif
-            nds.l = __synctex_closest_deep_child_v2(&hit, node);
+            /*  Index 1 is the first child of the sheet */
+            node = geometry->node[1];
+            nds.l = _synctex_geometry_closest_deep_child(geometry, &hit, 1);
 #if defined(SYNCTEX_DEBUG)
             printf("Edit query best: %i\n", nds.l.distance);
 #endif
@@ -8171,15 +10981,134 @@ synctex_iterator_p synctex_iterator_new_edit(synctex_scanner_p scanner, int page
     return NULL;
 }
 
+synctex_iterator_p synctex_iterator_new_edit_knn(synctex_scanner_p scanner, int page, float h, float v, int k)
+{
+    synctex_node_p sheet = NULL;
+    _synctex_geometry_p geometry = NULL;
+    synctex_point_s hit;
+    synctex_iterator_p iterator = NULL;
+    int *found = NULL;
+    int count;
+    if (k <= 0 || NULL == (scanner = synctex_scanner_parse(scanner)) || 0 >= scanner->unit) { /*  scanner->unit must be >0 */
+        return NULL;
+    }
+    sheet = synctex_sheet(scanner, page);
+    if (NULL == sheet || NULL == (geometry = _synctex_scanner_geometry(scanner, sheet))) {
+        return NULL;
+    }
+    hit = (synctex_point_s){(h - scanner->x_offset) / scanner->unit, (v - scanner->y_offset) / scanner->unit};
+    if (NULL == (found = _synctex_malloc(k * sizeof(int)))) {
+        _synctex_error("!  synctex_iterator_new_edit_knn: malloc problem.");
+        return NULL;
+    }
+    if ((count = _synctex_geometry_nearest_leaves(geometry, &hit, k, found)) < 0) {
+        _synctex_error("!  synctex_iterator_new_edit_knn: malloc problem.");
+        _synctex_free(found);
+        return NULL;
+    }
+    iterator = _synctex_iterator_new_with_geometry(scanner, geometry, found, count);
+    _synctex_free(found);
+    return iterator;
+}
+
+static int _synctex_location_cmp(const void *a, const void *b)
+{
+    const _synctex_location_s *l = a;
+    const _synctex_location_s *r = b;
+    if (l->line != r->line) {
+        return l->line < r->line ? -1 : 1;
+    }
+    if (l->tag != r->tag) {
+        return l->tag < r->tag ? -1 : 1;
+    }
+    return l->index < r->index ? -1 : l->index > r->index;
+}
+synctex_iterator_p synctex_iterator_new_region(synctex_scanner_p scanner, int page, float h0, float v0, float h1, float v1)
+{
+    synctex_node_p sheet = NULL;
+    _synctex_geometry_p geometry = NULL;
+    synctex_point_s p0, p1;
+    synctex_box_s region;
+    _synctex_locations_s locations = {NULL, 0, 0};
+    synctex_iterator_p iterator = NULL;
+    int *indices;
+    int count, j;
+    if (NULL == (scanner = synctex_scanner_parse(scanner)) || 0 >= scanner->unit) { /*  scanner->unit must be >0 */
+        return NULL;
+    }
+    sheet = synctex_sheet(scanner, page);
+    if (NULL == sheet || NULL == (geometry = _synctex_scanner_geometry(scanner, sheet))) {
+        return NULL;
+    }
+    p0 = (synctex_point_s){(h0 - scanner->x_offset) / scanner->unit, (v0 - scanner->y_offset) / scanner->unit};
+    p1 = (synctex_point_s){(h1 - scanner->x_offset) / scanner->unit, (v1 - scanner->y_offset) / scanner->unit};
+    region.min.h = p0.h < p1.h ? p0.h : p1.h;
+    region.max.h = p0.h < p1.h ? p1.h : p0.h;
+    region.min.v = p0.v < p1.v ? p0.v : p1.v;
+    region.max.v = p0.v < p1.v ? p1.v : p0.v;
+    if (_synctex_geometry_region(geometry, &region, 0, &locations) < 0
+        || NULL == (indices = _synctex_malloc((locations.count + 1) * sizeof(int)))) {
+        _synctex_error("!  synctex_iterator_new_region: malloc problem.");
+        _synctex_free(locations.location);
+        return NULL;
+    }
+    /*  one node per tag and line, the first one in the sheet */
+    if (locations.count > 1) {
+        qsort(locations.location, locations.count, sizeof(_synctex_location_s), &_synctex_location_cmp);
+    }
+    for (j = 0, count = 0; j < locations.count; ++j) {
+        _synctex_location_s *location = locations.location + j;
+        if (j == 0 || location->line != location[-1].line || location->tag != location[-1].tag) {
+            indices[count++] = location->index;
+        }
+    }
+    iterator = _synctex_iterator_new_with_geometry(scanner, geometry, indices, count);
+    _synctex_free(indices);
+    _synctex_free(locations.location);
+    return iterator;
+}
+
+/*  Whether the node has the given tag and line, boxes being excluded on demand.
+ *  Same as testing _synctex_node_is_box, synctex_node_tag and synctex_node_line,
+ *  but with only one switch on the node type.
+ */
+static synctex_bool_t _synctex_display_match(synctex_node_p node, int tag, int line, synctex_bool_t exclude_box)
+{
+    int links;
+    switch (node->class_->type) {
+    case synctex_node_type_vbox:
+    case synctex_node_type_void_vbox:
+    case synctex_node_type_hbox:
+    case synctex_node_type_void_hbox:
+        if (exclude_box) {
+            return synctex_NO;
+        }
+        break;
+    case synctex_node_type_proxy_hbox:
+    case synctex_node_type_proxy_vbox:
+    case synctex_node_type_proxy:
+    case synctex_node_type_proxy_last:
+        /*  a proxy is a box, has a tag and a line when its target has */
+        node = _synctex_tree_target(node);
+        return node && _synctex_display_match(node, tag, line, exclude_box);
+    default:
+        break;
+    }
+    if ((links = _synctex_noxy_links(node)) < 0) {
+        return !(exclude_box && _synctex_node_is_box(node)) && tag == synctex_node_tag(node) && line == synctex_node_line(node);
+    }
+    return tag == SYNCTEX_FIXED_AT(node, links, tag) && line == SYNCTEX_FIXED_AT(node, links, line);
+}
 /**
  *  Loop the candidate friendly list to find the ones with the proper
  *  tag and line.
  *  Returns a tree of results targeting the found candidates.
  *  At the top level each sibling has its own page number.
  *  All the results with the same page number are linked by child/parent entry.
+ *  - parameter results: the scanner allocating the results
  *  - parameter candidate: a friendly list of candidates
  */
-static synctex_node_p _synctex_display_query_v2(synctex_node_p target, int tag, int line, synctex_bool_t exclude_box)
+static synctex_node_p _synctex_display_query_v2(synctex_scanner_p results, synctex_node_p target, int tag, int line, synctex_bool_t exclude_box)
 {
     synctex_node_p first_handle = NULL;
     /*  Search the first match */
@@ -8188,12 +11117,12 @@ static synctex_node_p _synctex_display_query_v2(synctex_node_p target, int tag,
     }
     do {
         int page;
-        if ((exclude_box && _synctex_node_is_box(target)) || (tag != synctex_node_tag(target)) || (line != synctex_node_line(target))) {
+        if (!_synctex_display_match(target, tag, line, exclude_box)) {
             continue;
         }
         /*  We found a first match, create
          *  a result handle targeting that candidate. */
-        first_handle = _synctex_new_handle_with_target(target);
+        first_handle = _synctex_new_result(results, target);
         if (first_handle == NULL) {
             return first_handle;
         }
@@ -8205,11 +11134,11 @@ static synctex_node_p _synctex_display_query_v2(synctex_node_p target, int tag,
         /*  Now create all the other results  */
         while ((target = _synctex_tree_friend(target))) {
             synctex_node_p result = NULL;
-            if ((exclude_box && _synctex_node_is_box(target)) || (tag != synctex_node_tag(target)) || (line != synctex_node_line(target))) {
+            if (!_synctex_display_match(target, tag, line, exclude_box)) {
                 continue;
             }
             /*  Another match, same page number ? */
-            result = _synctex_new_handle_with_target(target);
+            result = _synctex_new_result(results, target);
             if (NULL == result) {
                 return first_handle;
             }
@@ -8222,11 +11151,11 @@ static synctex_node_p _synctex_display_query_v2(synctex_node_p target, int tag,
                 __synctex_tree_set_sibling(first_handle, result);
                 while ((target = _synctex_tree_friend(target))) {
                     synctex_node_p same_page_node;
-                    if ((exclude_box && _synctex_node_is_box(target)) || (tag != synctex_node_tag(target)) || (line != synctex_node_line(target))) {
+                    if (!_synctex_display_match(target, tag, line, exclude_box)) {
                         continue;
                     }
                     /*  New match found, which page? */
-                    result = _synctex_new_handle_with_target(target);
+                    result = _synctex_new_result(results, target);
                     if (NULL == result) {
                         return first_handle;
                     }
@@ -8253,90 +11182,307 @@ static synctex_node_p _synctex_display_query_v2(synctex_node_p target, int tag,
     } while ((target = _synctex_tree_friend(target)));
     return first_handle;
 }
+#define SYNCTEX_DISPLAY_TRY_COUNT 100
+/*  The order in which a display query tries the lines around the given one:
+ *  the given line first, then alternately after and before it,
+ *  lines before the first one being skipped.
+ */
+static SYNCTEX_INLINE int _synctex_display_try(int line, int other)
+{
+    int start = line < 1 ? 1 : line;
+    int d = other - start;
+    return (d > 0 ? d + (d - 1 < start - 1 ? d - 1 : start - 1) : -2 * d) + start - line;
+}
+/*  The lines tried by a display query, the given line and the mapped lines around it,
+ *  including the ones only mapped by the pending proxies,
+ *  in the order of the tries, up to SYNCTEX_DISPLAY_TRY_COUNT.
+ *  All the lines around when the mapped lines are not known.
+ *  - returns: the number of lines.
+ */
+static int _synctex_scanner_display_lines(synctex_scanner_p scanner, int tag, int line, int max_line, int *lines)
+{
+    int tries[SYNCTEX_DISPLAY_TRY_COUNT];
+    int first = line - SYNCTEX_DISPLAY_TRY_COUNT / 2;
+    int last = line + SYNCTEX_DISPLAY_TRY_COUNT - 1;
+    int count = 0, i, j;
+    /*  The friends added since the mapped lines were sorted are proxies to the forms,
+     *  like the pending ones */
+    synctex_bool_t forms = scanner->proxies.count || scanner->lines.count != scanner->friends.count;
+    memset(tries, 0, sizeof(tries));
+    if (first < 1) {
+        first = 1;
+    }
+    if (last > max_line) {
+        last = max_line;
+    }
+    if (scanner->lines.entries && (!forms || _synctex_scanner_index_form_lines(scanner))) {
+        _synctex_friend_s *keys[2];
+        int n[2] = {0, 0};
+        keys[0] = _synctex_keys_range(scanner->lines.entries, scanner->lines.count, tag, first, last, n);
+        keys[1] = forms ? _synctex_keys_range(scanner->form_lines.entries, scanner->form_lines.count, tag, first, last, n + 1) : NULL;
+        for (j = 0; j < 2; ++j) {
+            for (i = 0; i < n[j]; ++i) {
+                int k = _synctex_display_try(line, keys[j][i].line);
+                if (k < SYNCTEX_DISPLAY_TRY_COUNT) {
+                    tries[k] = keys[j][i].line;
+                }
+            }
+        }
+    } else {
+        for (i = first; i <= last; ++i) {
+            int k = _synctex_display_try(line, i);
+            if (k < SYNCTEX_DISPLAY_TRY_COUNT) {
+                tries[k] = i;
+            }
+        }
+    }
+    lines[count++] = line;
+#if !defined(__SYNCTEX_STRONG_DISPLAY_QUERY__)
+    for (i = 1; i < SYNCTEX_DISPLAY_TRY_COUNT; ++i) {
+        if (tries[i]) {
+            lines[count++] = tries[i];
+        }
+    }
+#endif
+    return count;
+}
 synctex_iterator_p synctex_iterator_new_display(synctex_scanner_p scanner, const char *name, int line, int column, int page_hint)
 {
     SYNCTEX_UNUSED(column)
     if (scanner) {
         int tag = synctex_scanner_get_tag(scanner, name); /* parse if necessary */
         int max_line = 0;
-        int line_offset = 1;
-        int try_count = 100;
+        int lines[SYNCTEX_DISPLAY_TRY_COUNT];
+        int n = 0, i;
         synctex_node_p node = NULL;
         synctex_node_p result = NULL;
+        synctex_scanner_p results = NULL;
         if (tag == 0) {
             printf("SyncTeX Warning: No tag for %s\n", name);
             return NULL;
         }
+        /*  Friends and input lines are recorded while parsing the sheets */
+        _synctex_scanner_parse_sheets(scanner);
         node = synctex_scanner_input_with_tag(scanner, tag);
         max_line = _synctex_data_line(node);
         /*  node = NULL; */
         if (line > max_line) {
             line = max_line;
         }
-        while (try_count--) {
-            if (line <= max_line) {
-                /*  This loop will only be performed once for advanced viewers */
-                synctex_node_p friend = _synctex_scanner_friend(scanner, tag + line);
-                if ((node = friend)) {
-                    result = _synctex_display_query_v2(node, tag, line, synctex_YES);
-                    if (!result) {
-                        /*  We did not find any matching boundary, retry including boxes */
-                        node = friend; /*  no need to test it again, already done */
-                        result = _synctex_display_query_v2(node, tag, line, synctex_NO);
-                    }
-                    /*  Now reverse the order to have nodes in display order, and then keep just a few nodes.
-                     *  Order first the best node. */
-                    /*  The result is a tree. At the root level, all nodes
-                     *  correspond to different page numbers.
-                     *  Each node has a child which corresponds to the same
-                     *  page number if relevant.
-                     *  Then reorder the nodes to put first the one which fits best.
-                     *  The idea is to count the number of nodes
-                     *  with the same tag and line number in the parents
-                     *  and choose the ones with the biggest count.
-                     */
-                    if (result) {
-                        /*  navigate through siblings, then children   */
-                        synctex_node_p next_sibling = __synctex_tree_reset_sibling(result);
-                        int best_match = abs(page_hint - _synctex_node_target_page(result));
-                        synctex_node_p sibling;
-                        int match;
-                        _synctex_counted_node_s cn = _synctex_vertically_sorted_v2(result);
-                        int count = cn.count;
-                        result = cn.node;
-                        while ((sibling = next_sibling)) {
-                            /* What is next? Do not miss that step! */
-                            next_sibling = __synctex_tree_reset_sibling(sibling);
-                            cn = _synctex_vertically_sorted_v2(sibling);
-                            count += cn.count;
-                            sibling = cn.node;
-                            match = abs(page_hint - _synctex_node_target_page(sibling));
-                            if (match < best_match) {
-                                /*  Order this node first */
-                                __synctex_tree_set_sibling(sibling, result);
-                                result = sibling;
-                                best_match = match;
-                            } else /*if (match>=best_match)*/ {
-                                __synctex_tree_set_sibling(sibling, __synctex_tree_sibling(result));
-                                __synctex_tree_set_sibling(result, sibling);
-                            }
+        if (NULL == (results = _synctex_scanner_new_results(scanner))) {
+            return NULL;
+        }
+        lines[0] = line;
+        for (i = 0, n = 1; i < n; ++i) {
+            synctex_node_p friend = NULL;
+            line = lines[i];
+            _synctex_scanner_register_line_proxies(scanner, tag, line, line);
+            friend = _synctex_scanner_friend(scanner, tag, line);
+            if ((node = friend)) {
+                result = _synctex_display_query_v2(results, node, tag, line, synctex_YES);
+                if (!result) {
+                    /*  We did not find any matching boundary, retry including boxes */
+                    node = friend; /*  no need to test it again, already done */
+                    result = _synctex_display_query_v2(results, node, tag, line, synctex_NO);
+                }
+                /*  Now reverse the order to have nodes in display order, and then keep just a few nodes.
+                 *  Order first the best node. */
+                /*  The result is a tree. At the root level, all nodes
+                 *  correspond to different page numbers.
+                 *  Each node has a child which corresponds to the same
+                 *  page number if relevant.
+                 *  Then reorder the nodes to put first the one which fits best.
+                 *  The idea is to count the number of nodes
+                 *  with the same tag and line number in the parents
+                 *  and choose the ones with the biggest count.
+                 */
+                if (result) {
+                    /*  navigate through siblings, then children   */
+                    synctex_node_p next_sibling = __synctex_tree_reset_sibling(result);
+                    int best_match = abs(page_hint - _synctex_node_target_page(result));
+                    synctex_node_p sibling;
+                    int match;
+                    _synctex_counted_node_s cn = _synctex_vertically_sorted_v2(result);
+                    int count = cn.count;
+                    result = cn.node;
+                    while ((sibling = next_sibling)) {
+                        /* What is next? Do not miss that step! */
+                        next_sibling = __synctex_tree_reset_sibling(sibling);
+                        cn = _synctex_vertically_sorted_v2(sibling);
+                        count += cn.count;
+                        sibling = cn.node;
+                        match = abs(page_hint - _synctex_node_target_page(sibling));
+                        if (match < best_match) {
+                            /*  Order this node first */
+                            __synctex_tree_set_sibling(sibling, result);
+                            result = sibling;
+                            best_match = match;
+                        } else /*if (match>=best_match)*/ {
+                            __synctex_tree_set_sibling(sibling, __synctex_tree_sibling(result));
+                            __synctex_tree_set_sibling(result, sibling);
                         }
-                        return _synctex_iterator_new(result, count);
                     }
+                    return _synctex_iterator_new(scanner, results, result, count);
                 }
-#if defined(__SYNCTEX_STRONG_DISPLAY_QUERY__)
-                break;
-#else
-                line += line_offset;
-                line_offset = line_offset < 0 ? -(line_offset - 1) : -(line_offset + 1);
-                if (line <= 0) {
-                    line += line_offset;
-                    line_offset = line_offset < 0 ? -(line_offset - 1) : -(line_offset + 1);
+            }
+            if (0 == i) {
+                /*  Not mapped, try the mapped lines around, the nearest first */
+                n = _synctex_scanner_display_lines(scanner, tag, line, max_line, lines);
+            }
+        }
+        _synctex_scanner_free_results(scanner, results);
+    }
+    return NULL;
+}
+/*  A box enclosing a result of a display range query */
+typedef struct {
+    int page;
+    synctex_box_s box;
+    synctex_node_p node;
+} _synctex_page_box_s;
+
+static int _synctex_page_box_cmp(const void *a, const void *b)
+{
+    const _synctex_page_box_s *l = a;
+    const _synctex_page_box_s *r = b;
+    if (l->page != r->page) {
+        return l->page < r->page ? -1 : 1;
+    }
+    if (l->box.min.v != r->box.min.v) {
+        return l->box.min.v < r->box.min.v ? -1 : 1;
+    }
+    if (l->box.min.h != r->box.min.h) {
+        return l->box.min.h < r->box.min.h ? -1 : 1;
+    }
+    return (uintptr_t)l->node < (uintptr_t)r->node ? -1 : (uintptr_t)l->node > (uintptr_t)r->node;
+}
+/*  Append the visible boxes of the nodes with the given tag and line,
+ *  the boxes themselves being results only when nothing else matches,
+ *  as for display queries.
+ *  - returns: yorn, NO on allocation failure.
+ */
+static synctex_bool_t _synctex_display_range_add(synctex_node_p friend, int tag, int line, _synctex_page_box_s **boxes, int *count, int *capacity)
+{
+    synctex_bool_t exclude_box = synctex_YES;
+    int old_count = *count;
+    do {
+        synctex_node_p node;
+        for (node = friend; node; node = _synctex_tree_friend(node)) {
+            synctex_node_p box;
+            if (!_synctex_display_match(node, tag, line, exclude_box) || NULL == (box = _synctex_node_box_visible(node))) {
+                continue;
+            }
+            if (*count == *capacity) {
+                int more_capacity = *capacity ? 2 * *capacity : SYNCTEX_RTREE_FOUND_MAX;
+                _synctex_page_box_s *more = realloc(*boxes, more_capacity * sizeof(_synctex_page_box_s));
+                if (NULL == more) {
+                    return synctex_NO;
                 }
-#endif
+                *boxes = more;
+                *capacity = more_capacity;
+            }
+            (*boxes)[(*count)++] = (_synctex_page_box_s){synctex_node_page(node), _synctex_data_box_V(box), box};
+        }
+        exclude_box = !exclude_box;
+    } while (!exclude_box && *count == old_count);
+    return synctex_YES;
+}
+synctex_iterator_p synctex_iterator_new_display_range(synctex_scanner_p scanner, const char *name, int first_line, int last_line)
+{
+    _synctex_friend_s *key;
+    _synctex_page_box_s *boxes = NULL;
+    int count = 0, capacity = 0;
+    synctex_rect_p rects = NULL;
+    synctex_node_p first = NULL;
+    synctex_node_p last = NULL;
+    synctex_iterator_p iterator = NULL;
+    synctex_scanner_p results = NULL;
+    int tag, n, i, j, k;
+    if (NULL == scanner) {
+        return NULL;
+    }
+    if (0 == (tag = synctex_scanner_get_tag(scanner, name))) { /* parse if necessary */
+        printf("SyncTeX Warning: No tag for %s\n", name);
+        return NULL;
+    }
+    /*  Friends are recorded while parsing the sheets */
+    _synctex_scanner_parse_sheets(scanner);
+    _synctex_scanner_register_line_proxies(scanner, tag, first_line, last_line);
+    if (NULL == (key = _synctex_scanner_lines(scanner, tag, first_line, last_line, &n))) {
+        return NULL;
+    }
+    for (i = 0; i < n; ++i) {
+        if (!_synctex_display_range_add(_synctex_scanner_friend(scanner, tag, key[i].line), tag, key[i].line, &boxes, &count, &capacity)) {
+            goto malloc_problem;
+        }
+    }
+    if (count == 0) {
+        return NULL;
+    }
+    if (NULL == (rects = _synctex_malloc(count * sizeof(synctex_rect_s))) || NULL == (results = _synctex_scanner_new_results(scanner))) {
+        goto malloc_problem;
+    }
+    /*  Merge the boxes of each page from top to bottom,
+     *  in the first box of the page sharing some horizontal extent, or in a new one.
+     *  The merged boxes are stored at the beginning of boxes. */
+    qsort(boxes, count, sizeof(_synctex_page_box_s), &_synctex_page_box_cmp);
+    for (i = 0, k = 0, n = 0; i < count; ++i) {
+        _synctex_page_box_s *B = boxes + i;
+        if (i > 0 && B->node == B[-1].node) {
+            continue;
+        }
+        if (n > 0 && boxes[n - 1].page != B->page) {
+            /*  k is the first merged box of the page */
+            k = n;
+        }
+        for (j = k; j < n; ++j) {
+            synctex_box_p box = &boxes[j].box;
+            if (B->box.min.h <= box->max.h && B->box.max.h >= box->min.h) {
+                box->min.h = B->box.min.h < box->min.h ? B->box.min.h : box->min.h;
+                box->max.h = B->box.max.h > box->max.h ? B->box.max.h : box->max.h;
+                box->min.v = B->box.min.v < box->min.v ? B->box.min.v : box->min.v;
+                box->max.v = B->box.max.v > box->max.v ? B->box.max.v : box->max.v;
+                break;
             }
         }
+        if (j == n) {
+            boxes[n++] = *B;
+        }
     }
+    for (i = 0; i < n; ++i) {
+        synctex_node_p handle;
+        synctex_box_p box = &boxes[i].box;
+        rects[i] = (synctex_rect_s){
+            boxes[i].page,
+            box->min.h * scanner->unit + scanner->x_offset,
+            box->min.v * scanner->unit + scanner->y_offset,
+            (box->max.h - box->min.h) * scanner->unit,
+            (box->max.v - box->min.v) * scanner->unit,
+        };
+        /*  The result is the top box of the rectangle */
+        if (NULL == (handle = _synctex_new_result(results, boxes[i].node))) {
+            _synctex_node_free(first);
+            goto malloc_problem;
+        }
+        if (last) {
+            _synctex_tree_set_sibling(last, handle);
+        } else {
+            first = handle;
+        }
+        last = handle;
+    }
+    if (NULL == (iterator = _synctex_iterator_new(scanner, results, first, n))) {
+        results = NULL;
+        goto malloc_problem;
+    }
+    iterator->rects = rects;
+    free(boxes);
+    return iterator;
+malloc_problem:
+    _synctex_error("!  synctex_iterator_new_display_range: malloc problem.");
+    _synctex_scanner_free_results(scanner, results);
+    _synctex_free(rects);
+    free(boxes);
     return NULL;
 }
 synctex_status_t synctex_display_query(synctex_scanner_p scanner, const char *name, int line, int column, int page_hint)
@@ -8390,7 +11536,7 @@ static _synctex_nd_s _synctex_point_h_ordered_distance_v2(synctex_point_p hit, s
 {
     _synctex_nd_s nd = {node, INT_MAX};
     if (node) {
-        int min, med, max, width;
+        int min, med, max, width, links;
         switch (synctex_node_type(node)) {
             /*  The distance between a point and a box is special.
              *  It is not the euclidian distance, nor something similar.
@@ -8411,8 +11557,9 @@ static _synctex_nd_s _synctex_point_h_ordered_distance_v2(synctex_point_p hit, s
         case synctex_node_type_void_vbox:
         case synctex_node_type_void_hbox:
             /*  getting the box bounds, taking into account negative width, height and depth. */
-            width = _synctex_data_width(node);
-            min = _synctex_data_h(node);
+            links = _synctex_noxy_links(node);
+            width = SYNCTEX_FIXED_AT(node, links, width);
+            min = SYNCTEX_FIXED_AT(node, links, h);
             max = min + (width > 0 ? width : -width);
             /*  We always have min <= max */
             if (hit->h < min) {
@@ -8457,13 +11604,13 @@ static _synctex_nd_s _synctex_point_h_ordered_distance_v2(synctex_point_p hit, s
              *  The distance to the kern is very special,
              *  in general, there is no text material in the kern,
              *  this is why we compute the offset relative to the closest edge of the kern.*/
-            max = _synctex_data_width(node);
+            max = SYNCTEX_FIXED(node, kern, width);
             if (max < 0) {
-                min = _synctex_data_h(node);
+                min = SYNCTEX_FIXED(node, kern, h);
                 max = min - max;
             } else {
                 min = -max;
-                max = _synctex_data_h(node);
+                max = SYNCTEX_FIXED(node, kern, h);
                 min += max;
             }
             med = (min + max) / 2;
@@ -8498,7 +11645,7 @@ static _synctex_nd_s _synctex_point_h_ordered_distance_v2(synctex_point_p hit, s
         case synctex_node_type_math:
         case synctex_node_type_boundary:
         case synctex_node_type_box_bdry:
-            nd.distance = _synctex_data_h(node) - hit->h;
+            nd.distance = SYNCTEX_FIXED_AT(node, _synctex_noxy_links(node), h) - hit->h;
             break;
         case synctex_node_type_ref:
             nd.node = synctex_node_child(node);
@@ -8530,7 +11677,7 @@ static _synctex_nd_s _synctex_point_h_ordered_distance_v2(synctex_point_p hit, s
 static _synctex_nd_s _synctex_point_v_ordered_distance_v2(synctex_point_p hit, synctex_node_p node)
 {
     _synctex_nd_s nd = {node, INT_MAX};
-    int min, max, depth, height;
+    int min, max, depth, height, links;
     switch (synctex_node_type(node)) {
         /*  The distance between a point and a box is special.
          *  It is not the euclidian distance, nor something similar.
@@ -8551,9 +11698,10 @@ static _synctex_nd_s _synctex_point_v_ordered_distance_v2(synctex_point_p hit, s
     case synctex_node_type_void_vbox:
     case synctex_node_type_void_hbox:
         /*  getting the box bounds, taking into account negative width, height and depth. */
-        min = synctex_node_v(node);
-        max = min + _synctex_abs(_synctex_data_depth(node));
-        min -= _synctex_abs(_synctex_data_height(node));
+        links = _synctex_noxy_links(node);
+        min = SYNCTEX_FIXED_AT(node, links, v);
+        max = min + _synctex_abs(SYNCTEX_FIXED_AT(node, links, depth));
+        min -= _synctex_abs(SYNCTEX_FIXED_AT(node, links, height));
         /*  We always have min <= max */
         if (hit->v < min) {
             nd.distance = min - hit->v; /*  regions 1+2+3, result is > 0 */
@@ -8598,7 +11746,7 @@ static _synctex_nd_s _synctex_point_v_ordered_distance_v2(synctex_point_p hit, s
     case synctex_node_type_kern:
     case synctex_node_type_glue:
     case synctex_node_type_math:
-        min = _synctex_data_v(node);
+        min = SYNCTEX_FIXED_AT(node, _synctex_noxy_links(node), v);
         max = min + _synctex_abs(_synctex_data_depth(_synctex_tree_parent(node)));
         min -= _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
         /*  We always have min <= max */
@@ -8748,11 +11896,11 @@ static int _synctex_point_node_distance_v2(synctex_point_p hit, synctex_node_p n
         int dd = INT_MAX;
         switch (synctex_node_type(node)) {
         case synctex_node_type_vbox:
-            box.min.h = _synctex_data_h(node);
-            box.max.h = box.min.h + _synctex_abs(_synctex_data_width(node));
-            box.min.v = synctex_node_v(node);
-            box.max.v = box.min.v + _synctex_abs(_synctex_data_depth(node));
-            box.min.v -= _synctex_abs(_synctex_data_height(node));
+            box.min.h = SYNCTEX_FIXED(node, vbox, h);
+            box.max.h = box.min.h + _synctex_abs(SYNCTEX_FIXED(node, vbox, width));
+            box.min.v = SYNCTEX_FIXED(node, vbox, v);
+            box.max.v = box.min.v + _synctex_abs(SYNCTEX_FIXED(node, vbox, depth));
+            box.min.v -= _synctex_abs(SYNCTEX_FIXED(node, vbox, height));
             return _synctex_distance_to_box_v2(hit, &box);
         case synctex_node_type_proxy_vbox:
             box.min.h = synctex_node_h(node);
@@ -8772,35 +11920,38 @@ static int _synctex_point_node_distance_v2(synctex_point_p hit, synctex_node_p n
         case synctex_node_type_void_vbox:
         case synctex_node_type_void_hbox:
             /*  best of distances from the left edge and right edge*/
-            box.min.h = _synctex_data_h(node);
+            /*  void boxes share the same layout */
+            box.min.h = SYNCTEX_FIXED(node, void_vbox, h);
             box.max.h = box.min.h;
-            box.min.v = _synctex_data_v(node);
-            box.max.v = box.min.v + _synctex_abs(_synctex_data_depth(node));
-            box.min.v -= _synctex_abs(_synctex_data_height(node));
+            box.min.v = SYNCTEX_FIXED(node, void_vbox, v);
+            box.max.v = box.min.v + _synctex_abs(SYNCTEX_FIXED(node, void_vbox, depth));
+            box.min.v -= _synctex_abs(SYNCTEX_FIXED(node, void_vbox, height));
             d = _synctex_distance_to_box_v2(hit, &box);
-            box.min.h = box.min.h + _synctex_abs(_synctex_data_width(node));
+            box.min.h = box.min.h + _synctex_abs(SYNCTEX_FIXED(node, void_vbox, width));
             box.max.h = box.min.h;
             dd = _synctex_distance_to_box_v2(hit, &box);
             return d < dd ? d : dd;
         case synctex_node_type_kern:
-            box.min.h = _synctex_data_h(node);
+            box.min.h = SYNCTEX_FIXED(node, kern, h);
             box.max.h = box.min.h;
-            box.max.v = _synctex_data_v(node);
+            box.max.v = SYNCTEX_FIXED(node, kern, v);
             box.min.v = box.max.v - _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
             d = _synctex_distance_to_box_v2(hit, &box);
-            box.min.h -= _synctex_data_width(node);
+            box.min.h -= SYNCTEX_FIXED(node, kern, width);
             box.max.h = box.min.h;
             dd = _synctex_distance_to_box_v2(hit, &box);
             return d < dd ? d : dd;
         case synctex_node_type_glue:
         case synctex_node_type_math:
         case synctex_node_type_boundary:
-        case synctex_node_type_box_bdry:
-            box.min.h = _synctex_data_h(node);
+        case synctex_node_type_box_bdry: {
+            int links = _synctex_noxy_links(node);
+            box.min.h = SYNCTEX_FIXED_AT(node, links, h);
             box.max.h = box.min.h;
-            box.max.v = _synctex_data_v(node);
+            box.max.v = SYNCTEX_FIXED_AT(node, links, v);
             box.min.v = box.max.v - _synctex_abs(_synctex_data_height(_synctex_tree_parent(node)));
             return _synctex_distance_to_box_v2(hit, &box);
+        }
         case synctex_node_type_proxy:
         case synctex_node_type_proxy_last: {
             synctex_point_s otherHit = *hit;
@@ -9138,6 +12289,914 @@ static _synctex_nd_s __synctex_closest_deep_child_v2(synctex_point_p hitP, synct
     return best;
 }
 
+#ifdef SYNCTEX_NOTHING
+#pragma mark -
+#pragma mark Geometry store
+#endif
+
+/*  The number of nodes in the subtree of node.
+ *  Proxies to the content of forms are created on the fly, like synctex_node_next does.
+ */
+static int _synctex_geometry_count(synctex_node_p node)
+{
+    int count = 1;
+    synctex_node_p child = synctex_node_child(node);
+    while (child) {
+        count += _synctex_geometry_count(child);
+        child = synctex_node_sibling(child);
+    }
+    return count;
+}
+/*  Fill the columns at index i with the geometry of node, as seen by hit testing.
+ */
+static void _synctex_geometry_set(_synctex_geometry_p geometry, int i, synctex_node_p node)
+{
+    synctex_node_p target = node;
+    synctex_node_p parent = NULL;
+    int h = 0, v = 0;
+    /*  Proxies to leaves or to the last child of a form box
+     *  are offsets to their target. */
+    while (synctex_node_type(target) == synctex_node_type_proxy || synctex_node_type(target) == synctex_node_type_proxy_last) {
+        h += _synctex_data_h(target);
+        v += _synctex_data_v(target);
+        target = _synctex_tree_target(target);
+    }
+    geometry->node[i] = node;
+    geometry->type[i] = synctex_node_type(node);
+    geometry->shape[i] = synctex_node_type(target);
+    geometry->tag[i] = synctex_node_tag(node);
+    geometry->line[i] = synctex_node_line(node);
+    geometry->width[i] = geometry->height[i] = geometry->depth[i] = 0;
+    switch (geometry->shape[i]) {
+    case synctex_node_type_hbox:
+    case synctex_node_type_proxy_hbox:
+        geometry->h[i] = h + synctex_node_hbox_h(target);
+        geometry->v[i] = v + synctex_node_hbox_v(target);
+        geometry->width[i] = synctex_node_hbox_width(target);
+        geometry->height[i] = synctex_node_hbox_height(target);
+        geometry->depth[i] = synctex_node_hbox_depth(target);
+        break;
+    case synctex_node_type_vbox:
+    case synctex_node_type_void_vbox:
+    case synctex_node_type_void_hbox:
+    case synctex_node_type_proxy_vbox:
+        geometry->h[i] = h + synctex_node_h(target);
+        geometry->v[i] = v + synctex_node_v(target);
+        geometry->width[i] = synctex_node_width(target);
+        geometry->height[i] = synctex_node_height(target);
+        geometry->depth[i] = synctex_node_depth(target);
+        break;
+    case synctex_node_type_kern:
+    case synctex_node_type_glue:
+    case synctex_node_type_math:
+    case synctex_node_type_rule:
+    case synctex_node_type_boundary:
+    case synctex_node_type_box_bdry:
+        geometry->h[i] = h + _synctex_data_h(target);
+        geometry->v[i] = v + _synctex_data_v(target);
+        geometry->width[i] = _synctex_data_width(target);
+        if ((parent = _synctex_tree_parent(target))) {
+            geometry->height[i] = _synctex_data_height(parent);
+            geometry->depth[i] = _synctex_data_depth(parent);
+        }
+        break;
+    default:
+        geometry->h[i] = h;
+        geometry->v[i] = v;
+        break;
+    }
+}
+/*  Fill the subtree of node in preorder, node being at index i.
+ *  - returns: the index following the subtree.
+ */
+static int _synctex_geometry_fill(_synctex_geometry_p geometry, synctex_node_p node, int i)
+{
+    int j = i + 1;
+    synctex_node_p child = synctex_node_child(node);
+    _synctex_geometry_set(geometry, i, node);
+    while (child) {
+        j = _synctex_geometry_fill(geometry, child, j);
+        child = synctex_node_sibling(child);
+    }
+    return geometry->end[i] = j;
+}
+static int _synctex_node_index_cmp(const void *a, const void *b)
+{
+    uintptr_t l = (uintptr_t)((const _synctex_node_index_s *)a)->node;
+    uintptr_t r = (uintptr_t)((const _synctex_node_index_s *)b)->node;
+    return l < r ? -1 : l > r;
+}
+/*  Record the horizontal boxes in the next_hbox order of the sheet.
+ *  - returns: yorn
+ */
+static synctex_bool_t _synctex_geometry_fill_hbox(_synctex_geometry_p geometry)
+{
+    _synctex_node_index_s *sorted = NULL;
+    int count = 0;
+    int i;
+    synctex_node_p node;
+    for (i = 0; i < geometry->count; ++i) {
+        if (geometry->type[i] == synctex_node_type_hbox || geometry->type[i] == synctex_node_type_proxy_hbox) {
+            ++count;
+        }
+    }
+    if (count == 0) {
+        return synctex_YES;
+    }
+    if (NULL == (sorted = _synctex_malloc(count * sizeof(_synctex_node_index_s)))) {
+        return synctex_NO;
+    }
+    for (count = 0, i = 0; i < geometry->count; ++i) {
+        if (geometry->type[i] == synctex_node_type_hbox || geometry->type[i] == synctex_node_type_proxy_hbox) {
+            sorted[count++] = (_synctex_node_index_s){geometry->node[i], i};
+        }
+    }
+    qsort(sorted, count, sizeof(_synctex_node_index_s), &_synctex_node_index_cmp);
+    node = geometry->sheet;
+    while ((node = _synctex_tree_next_hbox(node)) && geometry->hbox_count < count) {
+        _synctex_node_index_s key = {node, 0};
+        _synctex_node_index_s *found = bsearch(&key, sorted, count, sizeof(_synctex_node_index_s), &_synctex_node_index_cmp);
+        if (found) {
+            geometry->hbox[geometry->hbox_count++] = found->index;
+        }
+    }
+    _synctex_free(sorted);
+    return synctex_YES;
+}
+typedef struct {
+    long key;
+    int index;
+} _synctex_key_index_s;
+
+static int _synctex_key_index_cmp(const void *a, const void *b)
+{
+    const _synctex_key_index_s *l = a;
+    const _synctex_key_index_s *r = b;
+    if (l->key != r->key) {
+        return l->key < r->key ? -1 : 1;
+    }
+    return l->index < r->index ? -1 : l->index > r->index;
+}
+/*  Build a packed R-tree over the n given leaf boxes, leaf k standing for item[k].
+ *  The leaves are ordered by sort tile recursive:
+ *  sorted by h center in vertical slices, then by v center in each slice.
+ *  Each level groups SYNCTEX_RTREE_FANOUT consecutive nodes of the level below.
+ *  - returns: yorn
+ */
+static synctex_bool_t _synctex_rtree_build(_synctex_rtree_s *rtree, synctex_box_s *leaf, int *item, int n)
+{
+    int total = n;
+    int count = n;
+    int levels = 1;
+    int slice, k, level;
+    _synctex_key_index_s *sorted;
+    synctex_box_s *box;
+    int *index;
+    if (n == 0) {
+        return synctex_YES;
+    }
+    while (count > 1) {
+        if (levels > SYNCTEX_RTREE_MAX_LEVEL) {
+            return synctex_NO;
+        }
+        count = (count + SYNCTEX_RTREE_FANOUT - 1) / SYNCTEX_RTREE_FANOUT;
+        total += count;
+        ++levels;
+    }
+    if (NULL == (sorted = _synctex_malloc(n * sizeof(_synctex_key_index_s)))) {
+        return synctex_NO;
+    }
+    if (NULL == (box = _synctex_malloc(total * (sizeof(synctex_box_s) + sizeof(int))))) {
+        _synctex_free(sorted);
+        return synctex_NO;
+    }
+    index = (int *)(box + total);
+    for (k = 0; k < n; ++k) {
+        sorted[k] = (_synctex_key_index_s){(long)leaf[k].min.h + leaf[k].max.h, k};
+    }
+    qsort(sorted, n, sizeof(_synctex_key_index_s), &_synctex_key_index_cmp);
+    /*  the number of leaves in each vertical slice:
+     *  FANOUT times the square root of the number of leaf nodes */
+    for (slice = 1; slice * slice * SYNCTEX_RTREE_FANOUT < n; ++slice) {
+    }
+    slice *= SYNCTEX_RTREE_FANOUT;
+    for (k = 0; k < n; k += slice) {
+        int j;
+        for (j = k; j < k + slice && j < n; ++j) {
+            synctex_box_p b = leaf + sorted[j].index;
+            sorted[j].key = (long)b->min.v + b->max.v;
+        }
+        qsort(sorted + k, j - k, sizeof(_synctex_key_index_s), &_synctex_key_index_cmp);
+    }
+    for (k = 0; k < n; ++k) {
+        box[k] = leaf[sorted[k].index];
+        index[k] = item[sorted[k].index];
+    }
+    _synctex_free(sorted);
+    rtree->level[0] = 0;
+    rtree->level[1] = n;
+    for (level = 1; level < levels; ++level) {
+        int first = rtree->level[level - 1];
+        int end = rtree->level[level];
+        int parent = end;
+        for (k = first; k < end; k += SYNCTEX_RTREE_FANOUT, ++parent) {
+            int j;
+            box[parent] = box[k];
+            index[parent] = k;
+            for (j = k + 1; j < k + SYNCTEX_RTREE_FANOUT && j < end; ++j) {
+                if (box[j].min.h < box[parent].min.h) {
+                    box[parent].min.h = box[j].min.h;
+                }
+                if (box[j].min.v < box[parent].min.v) {
+                    box[parent].min.v = box[j].min.v;
+                }
+                if (box[j].max.h > box[parent].max.h) {
+                    box[parent].max.h = box[j].max.h;
+                }
+                if (box[j].max.v > box[parent].max.v) {
+                    box[parent].max.v = box[j].max.v;
+                }
+            }
+        }
+        rtree->level[level + 1] = parent;
+    }
+    rtree->box = box;
+    rtree->index = index;
+    rtree->levels = levels;
+    return synctex_YES;
+}
+/*  The children of the node k, which is not a leaf,
+ *  are the FANOUT nodes from index[k], up to the end of the level below.
+ *  - returns: the end of the children.
+ */
+static SYNCTEX_INLINE int _synctex_rtree_children_end(_synctex_rtree_s *rtree, int k)
+{
+    int level = 1;
+    int first = rtree->index[k];
+    while (rtree->level[level] <= first) {
+        ++level;
+    }
+    return first + SYNCTEX_RTREE_FANOUT < rtree->level[level] ? first + SYNCTEX_RTREE_FANOUT : rtree->level[level];
+}
+/*  Build the spatial index of the horizontal boxes,
+ *  with their rectangles as tested by _synctex_geometry_in_box.
+ *  - returns: yorn
+ */
+static synctex_bool_t _synctex_geometry_index_hbox(_synctex_geometry_p geometry)
+{
+    int n = geometry->hbox_count;
+    synctex_box_s *leaf;
+    int *item;
+    int k;
+    synctex_bool_t yorn;
+    if (n == 0) {
+        return synctex_YES;
+    }
+    if (NULL == (leaf = _synctex_malloc(n * (sizeof(synctex_box_s) + sizeof(int))))) {
+        return synctex_NO;
+    }
+    item = (int *)(leaf + n);
+    for (k = 0; k < n; ++k) {
+        int i = geometry->hbox[k];
+        leaf[k].min.h = geometry->h[i];
+        leaf[k].max.h = geometry->h[i] + _synctex_abs(geometry->width[i]);
+        leaf[k].min.v = geometry->v[i] - _synctex_abs(geometry->height[i]);
+        leaf[k].max.v = geometry->v[i] + _synctex_abs(geometry->depth[i]);
+        item[k] = k;
+    }
+    yorn = _synctex_rtree_build(&geometry->hbox_tree, leaf, item, n);
+    _synctex_free(leaf);
+    return yorn;
+}
+/*  Whether the shape is measured by _synctex_geometry_distance as one or two vertical segments.
+ *  These are the only candidates of __synctex_geometry_closest_deep_child
+ *  with a finite distance.
+ */
+static SYNCTEX_INLINE synctex_bool_t _synctex_geometry_is_leaf(int shape)
+{
+    switch (shape) {
+    case synctex_node_type_kern:
+    case synctex_node_type_glue:
+    case synctex_node_type_math:
+    case synctex_node_type_boundary:
+    case synctex_node_type_box_bdry:
+        return synctex_YES;
+    default:
+        return synctex_NO;
+    }
+}
+/*  Build the spatial index of the leaves,
+ *  each one bounded by the segments measured by _synctex_geometry_distance,
+ *  such that the distance to the bounds never exceeds the distance to the leaf.
+ *  - returns: yorn
+ */
+static synctex_bool_t _synctex_geometry_index_leaf(_synctex_geometry_p geometry)
+{
+    int n = 0;
+    synctex_box_s *leaf;
+    int *item;
+    int i;
+    synctex_bool_t yorn;
+    for (i = 1; i < geometry->count; ++i) {
+        if (_synctex_geometry_is_leaf(geometry->shape[i])) {
+            ++n;
+        }
+    }
+    if (n == 0) {
+        return synctex_YES;
+    }
+    if (NULL == (leaf = _synctex_malloc(n * (sizeof(synctex_box_s) + sizeof(int))))) {
+        return synctex_NO;
+    }
+    item = (int *)(leaf + n);
+    for (n = 0, i = 1; i < geometry->count; ++i) {
+        if (_synctex_geometry_is_leaf(geometry->shape[i])) {
+            leaf[n].min.h = leaf[n].max.h = geometry->h[i];
+            if (geometry->shape[i] == synctex_node_type_kern) {
+                /*  the kern is measured at both ends */
+                if (geometry->width[i] > 0) {
+                    leaf[n].min.h -= geometry->width[i];
+                } else {
+                    leaf[n].max.h -= geometry->width[i];
+                }
+            }
+            leaf[n].max.v = geometry->v[i];
+            leaf[n].min.v = geometry->v[i] - _synctex_abs(geometry->height[i]);
+            item[n++] = i;
+        }
+    }
+    yorn = _synctex_rtree_build(&geometry->leaf_tree, leaf, item, n);
+    _synctex_free(leaf);
+    return yorn;
+}
+static int _synctex_int_cmp(const void *a, const void *b)
+{
+    int l = *(const int *)a;
+    int r = *(const int *)b;
+    return l < r ? -1 : l > r;
+}
+/*  The horizontal boxes containing the hit point.
+ *  found points to an array of SYNCTEX_RTREE_FOUND_MAX integers,
+ *  replaced by a malloced one when there are more boxes.
+ *  - returns: the number of boxes, their positions in hbox
+ *      are stored in *found by increasing order,
+ *      -1 on allocation failure.
+ */
+static int _synctex_geometry_hbox_containing(_synctex_geometry_p geometry, synctex_point_p hit, int **found)
+{
+    _synctex_rtree_s *rtree = &geometry->hbox_tree;
+    /*  depth first, at most FANOUT - 1 pending siblings per level */
+    int stack[SYNCTEX_RTREE_FANOUT * SYNCTEX_RTREE_MAX_LEVEL + 1];
+    int top = 0;
+    int count = 0;
+    int capacity = SYNCTEX_RTREE_FOUND_MAX;
+    int *result = *found;
+    if (rtree->levels == 0) {
+        return 0;
+    }
+    stack[top++] = rtree->level[rtree->levels] - 1;
+    while (top > 0) {
+        int k = stack[--top];
+        synctex_box_s *box = rtree->box + k;
+        if (hit->h < box->min.h || hit->h > box->max.h || hit->v < box->min.v || hit->v > box->max.v) {
+            continue;
+        }
+        if (k < rtree->level[1]) {
+            if (count == capacity) {
+                int *more = _synctex_malloc(2 * capacity * sizeof(int));
+                if (NULL == more) {
+                    if (result != *found) {
+                        _synctex_free(result);
+                    }
+                    return -1;
+                }
+                memcpy(more, result, count * sizeof(int));
+                if (result != *found) {
+                    _synctex_free(result);
+                }
+                result = more;
+                capacity *= 2;
+            }
+            result[count++] = rtree->index[k];
+        } else {
+            int first = rtree->index[k];
+            int end = _synctex_rtree_children_end(rtree, k);
+            while (end > first) {
+                stack[top++] = --end;
+            }
+        }
+    }
+    qsort(result, count, sizeof(int), &_synctex_int_cmp);
+    *found = result;
+    return count;
+}
+/*  Free the given geometry store and its indices.
+ */
+static void _synctex_geometry_free(_synctex_geometry_p geometry)
+{
+    _synctex_free(geometry->hbox_tree.box);
+    _synctex_free(geometry->leaf_tree.box);
+    _synctex_free(geometry);
+}
+/*  The geometry store of the given sheet, built on first use.
+ *  - returns: the store, NULL on allocation failure.
+ */
+static _synctex_geometry_p _synctex_scanner_geometry(synctex_scanner_p scanner, synctex_node_p sheet)
+{
+    _synctex_geometry_p geometry = scanner->geometry;
+    int page = _synctex_data_page(sheet);
+    size_t count;
+    if (_synctex_directory_get_geometry(&scanner->sheet_by_page, page, sheet, &geometry)) {
+        if (geometry) {
+            return geometry;
+        }
+    } else {
+        /*  The sheet is too sparse for the directory */
+        while (geometry) {
+            if (geometry->sheet == sheet) {
+                return geometry;
+            }
+            geometry = geometry->next;
+        }
+    }
+    /*  Hit tests follow the next hbox links of the proxies */
+    _synctex_scanner_register_sheet_proxies(scanner, sheet);
+    count = (size_t)_synctex_geometry_count(sheet);
+    /*  One block: the nodes, then 11 columns, the hbox one included. */
+    if (NULL == (geometry = _synctex_malloc(sizeof(_synctex_geometry_s) + count * (sizeof(synctex_node_p) + 11 * sizeof(int))))) {
+        _synctex_error("!  _synctex_scanner_geometry: malloc problem.");
+        return NULL;
+    }
+    geometry->sheet = sheet;
+    geometry->count = (int)count;
+    geometry->node = (synctex_node_p *)(geometry + 1);
+    geometry->type = (int *)(geometry->node + count);
+    geometry->shape = geometry->type + count;
+    geometry->tag = geometry->shape + count;
+    geometry->line = geometry->tag + count;
+    geometry->h = geometry->line + count;
+    geometry->v = geometry->h + count;
+    geometry->width = geometry->v + count;
+    geometry->height = geometry->width + count;
+    geometry->depth = geometry->height + count;
+    geometry->end = geometry->depth + count;
+    geometry->hbox = geometry->end + count;
+    _synctex_geometry_fill(geometry, sheet, 0);
+    if (!_synctex_geometry_fill_hbox(geometry) || !_synctex_geometry_index_hbox(geometry) || !_synctex_geometry_index_leaf(geometry)) {
+        _synctex_error("!  _synctex_scanner_geometry: malloc problem.");
+        _synctex_geometry_free(geometry);
+        return NULL;
+    }
+    geometry->next = scanner->geometry;
+    scanner->geometry = geometry;
+    /*  On failure, the list is browsed instead */
+    _synctex_directory_set_geometry(&scanner->sheet_by_page, page, sheet, geometry);
+    return geometry;
+}
+static void _synctex_scanner_free_geometry(synctex_scanner_p scanner)
+{
+    while (scanner->geometry) {
+        _synctex_geometry_p next = scanner->geometry->next;
+        _synctex_geometry_free(scanner->geometry);
+        scanner->geometry = next;
+    }
+}
+/*  Same as _synctex_point_in_box_v2 for the node at index i.
+ */
+static SYNCTEX_INLINE synctex_bool_t _synctex_geometry_in_box(_synctex_geometry_p geometry, int i, synctex_point_p hit)
+{
+    switch (geometry->shape[i]) {
+    case synctex_node_type_hbox:
+    case synctex_node_type_proxy_hbox:
+    case synctex_node_type_vbox:
+    case synctex_node_type_proxy_vbox:
+    case synctex_node_type_void_vbox:
+    case synctex_node_type_void_hbox:
+        return hit->h >= geometry->h[i] && hit->h <= geometry->h[i] + _synctex_abs(geometry->width[i])
+            && hit->v >= geometry->v[i] - _synctex_abs(geometry->height[i]) && hit->v <= geometry->v[i] + _synctex_abs(geometry->depth[i]);
+    case synctex_node_type_rule:
+    case synctex_node_type_glue:
+    case synctex_node_type_math:
+        return hit->h == geometry->h[i] && hit->v >= geometry->v[i] - _synctex_abs(geometry->height[i])
+            && hit->v <= geometry->v[i] + _synctex_abs(geometry->depth[i]);
+    default:
+        /*  Kerns and boundaries never contain the hit point */
+        return synctex_NO;
+    }
+}
+/*  The bounds of the node at index i, as hit tested by _synctex_geometry_in_box,
+ *  rules and kerns spanning their width.
+ */
+static synctex_box_s _synctex_geometry_bounds(_synctex_geometry_p geometry, int i)
+{
+    synctex_box_s box;
+    int width = geometry->width[i];
+    box.min.h = box.max.h = geometry->h[i];
+    switch (geometry->shape[i]) {
+    case synctex_node_type_hbox:
+    case synctex_node_type_proxy_hbox:
+    case synctex_node_type_vbox:
+    case synctex_node_type_proxy_vbox:
+    case synctex_node_type_void_vbox:
+    case synctex_node_type_void_hbox:
+        box.max.h += _synctex_abs(width);
+        break;
+    case synctex_node_type_rule:
+        /*  same as _synctex_data_box */
+        if (width < 0) {
+            box.min.h += width;
+        } else {
+            box.max.h += width;
+        }
+        break;
+    case synctex_node_type_kern:
+        /*  same as _synctex_data_xob */
+        if (width > 0) {
+            box.min.h -= width;
+        } else {
+            box.max.h -= width;
+        }
+        break;
+    default:
+        break;
+    }
+    box.min.v = geometry->v[i] - _synctex_abs(geometry->height[i]);
+    box.max.v = geometry->v[i] + _synctex_abs(geometry->depth[i]);
+    return box;
+}
+/*  Append the source locations of the subtree of node i that intersect the region:
+ *  the nodes without children, and the boxes none of which children intersect.
+ *  Subtrees of boxes that do not intersect the region are skipped.
+ *  - returns: the number of locations appended, -1 on allocation failure.
+ */
+static int _synctex_geometry_region(_synctex_geometry_p geometry, synctex_box_p region, int i, _synctex_locations_s *locations)
+{
+    int end = geometry->end[i];
+    int count = 0;
+    int child;
+    for (child = i + 1; child < end; child = geometry->end[child]) {
+        synctex_box_s box = _synctex_geometry_bounds(geometry, child);
+        if (box.max.h < region->min.h || box.min.h > region->max.h || box.max.v < region->min.v || box.min.v > region->max.v) {
+            continue;
+        }
+        if (child + 1 < geometry->end[child]) {
+            int n = _synctex_geometry_region(geometry, region, child, locations);
+            if (n < 0) {
+                return -1;
+            } else if (n > 0) {
+                count += n;
+                continue;
+            }
+        }
+        if (geometry->tag[child] <= 0) {
+            continue;
+        }
+        if (locations->count == locations->capacity) {
+            int capacity = locations->capacity ? 2 * locations->capacity : SYNCTEX_RTREE_FOUND_MAX;
+            _synctex_location_s *more = realloc(locations->location, capacity * sizeof(_synctex_location_s));
+            if (NULL == more) {
+                return -1;
+            }
+            locations->location = more;
+            locations->capacity = capacity;
+        }
+        locations->location[locations->count++] = (_synctex_location_s){geometry->line[child], geometry->tag[child], child};
+        ++count;
+    }
+    return count;
+}
+/*  Same as _synctex_point_node_distance_v2 for the node at index i.
+ */
+static int _synctex_geometry_distance(_synctex_geometry_p geometry, int i, synctex_point_p hit)
+{
+    synctex_box_s box = {{0, 0}, {0, 0}};
+    int d, dd;
+    switch (geometry->shape[i]) {
+    case synctex_node_type_hbox:
+    case synctex_node_type_proxy_hbox:
+    case synctex_node_type_vbox:
+    case synctex_node_type_proxy_vbox:
+        box.min.h = geometry->h[i];
+        box.max.h = box.min.h + _synctex_abs(geometry->width[i]);
+        box.min.v = geometry->v[i];
+        box.max.v = box.min.v + _synctex_abs(geometry->depth[i]);
+        box.min.v -= _synctex_abs(geometry->height[i]);
+        return _synctex_distance_to_box_v2(hit, &box);
+    case synctex_node_type_void_vbox:
+    case synctex_node_type_void_hbox:
+        /*  best of distances from the left edge and right edge*/
+        box.min.h = geometry->h[i];
+        box.max.h = box.min.h;
+        box.min.v = geometry->v[i];
+        box.max.v = box.min.v + _synctex_abs(geometry->depth[i]);
+        box.min.v -= _synctex_abs(geometry->height[i]);
+        d = _synctex_distance_to_box_v2(hit, &box);
+        box.min.h = box.min.h + _synctex_abs(geometry->width[i]);
+        box.max.h = box.min.h;
+        dd = _synctex_distance_to_box_v2(hit, &box);
+        return d < dd ? d : dd;
+    case synctex_node_type_kern:
+        box.min.h = geometry->h[i];
+        box.max.h = box.min.h;
+        box.max.v = geometry->v[i];
+        box.min.v = box.max.v - _synctex_abs(geometry->height[i]);
+        d = _synctex_distance_to_box_v2(hit, &box);
+        box.min.h -= geometry->width[i];
+        box.max.h = box.min.h;
+        dd = _synctex_distance_to_box_v2(hit, &box);
+        return d < dd ? d : dd;
+    case synctex_node_type_glue:
+    case synctex_node_type_math:
+    case synctex_node_type_boundary:
+    case synctex_node_type_box_bdry:
+        box.min.h = geometry->h[i];
+        box.max.h = box.min.h;
+        box.max.v = geometry->v[i];
+        box.min.v = box.max.v - _synctex_abs(geometry->height[i]);
+        return _synctex_distance_to_box_v2(hit, &box);
+    default:
+        return INT_MAX;
+    }
+}
+/*  Same as _synctex_eq_deepest_container_v2 for the node at index i.
+ *  - returns: the index of the container or -1.
+ */
+static int _synctex_geometry_deepest_container(_synctex_geometry_p geometry, synctex_point_p hit, int i)
+{
+    int end = geometry->end[i];
+    int child;
+    if (i + 1 < end) {
+        /*  We go deep first because some boxes have 0 dimensions
+         *  despite they do contain some black material.
+         */
+        for (child = i + 1; child < end; child = geometry->end[child]) {
+            if (_synctex_geometry_in_box(geometry, child, hit)) {
+                int deep = _synctex_geometry_deepest_container(geometry, hit, child);
+                if (deep >= 0) {
+                    /*  One of the children contains the hit. */
+                    return deep;
+                }
+            }
+        }
+        if (geometry->type[i] == synctex_node_type_vbox || geometry->type[i] == synctex_node_type_proxy_vbox) {
+            /*  For vboxes we try to use some node inside.
+             *  Walk through the list of siblings until we find the closest one.
+             *  Only consider siblings with children inside. */
+            int best = -1;
+            int best_distance = INT_MAX;
+            for (child = i + 1; child < end; child = geometry->end[child]) {
+                if (child + 1 < geometry->end[child]) {
+                    int d = _synctex_geometry_distance(geometry, child, hit);
+                    if (d <= best_distance) {
+                        best = child;
+                        best_distance = d;
+                    }
+                }
+            }
+            if (best >= 0) {
+                return best;
+            }
+        }
+        if (_synctex_geometry_in_box(geometry, i, hit)) {
+            return i;
+        }
+    }
+    return -1;
+}
+typedef struct {
+    int index;
+    int distance;
+} _synctex_id_s;
+
+static _synctex_id_s __synctex_geometry_closest_deep_child(_synctex_geometry_p geometry, synctex_point_p hit, int i)
+{
+    _synctex_id_s best = {-1, INT_MAX};
+    int end = geometry->end[i];
+    int child;
+    for (child = i + 1; child < end; child = geometry->end[child]) {
+        _synctex_id_s id;
+        switch (geometry->shape[child]) {
+        case synctex_node_type_hbox:
+        case synctex_node_type_proxy_hbox:
+        case synctex_node_type_vbox:
+        case synctex_node_type_proxy_vbox:
+        case synctex_node_type_void_vbox:
+        case synctex_node_type_void_hbox:
+            id = __synctex_geometry_closest_deep_child(geometry, hit, child);
+            break;
+        default:
+            id = (_synctex_id_s){child, _synctex_geometry_distance(geometry, child, hit)};
+            break;
+        }
+        if (id.distance < best.distance || (id.distance == best.distance && (id.index < 0 || geometry->type[id.index] != synctex_node_type_kern))) {
+            best = id;
+        }
+    }
+    return best;
+}
+/*  Whether id is a better candidate than best for __synctex_geometry_closest_deep_child,
+ *  whatever the order of the visit.
+ *  Visiting in preorder, it keeps the closest node and at the same distance,
+ *  the last one that is not a kern, or else the first kern.
+ */
+static SYNCTEX_INLINE synctex_bool_t _synctex_geometry_closer(_synctex_geometry_p geometry, _synctex_id_s id, _synctex_id_s best)
+{
+    synctex_bool_t kern, best_kern;
+    if (best.index < 0 || id.distance != best.distance) {
+        return best.index < 0 || id.distance < best.distance;
+    }
+    kern = geometry->type[id.index] == synctex_node_type_kern;
+    best_kern = geometry->type[best.index] == synctex_node_type_kern;
+    if (kern != best_kern) {
+        return best_kern;
+    }
+    return kern ? id.index < best.index : id.index > best.index;
+}
+/*  Same as __synctex_geometry_closest_deep_child, by branch and bound in the leaf index.
+ *  - returns: {-1, INT_MAX} when no node of the subtree has a finite distance.
+ */
+static _synctex_id_s _synctex_geometry_closest_leaf(_synctex_geometry_p geometry, synctex_point_p hit, int i)
+{
+    _synctex_rtree_s *rtree = &geometry->leaf_tree;
+    int stack[SYNCTEX_RTREE_FANOUT * SYNCTEX_RTREE_MAX_LEVEL + 1];
+    int top = 0;
+    int end = geometry->end[i];
+    _synctex_id_s best = {-1, INT_MAX};
+    if (rtree->levels == 0) {
+        return best;
+    }
+    stack[top++] = rtree->level[rtree->levels] - 1;
+    while (top > 0) {
+        int k = stack[--top];
+        /*  ties are kept, they may win */
+        if (best.index >= 0 && _synctex_distance_to_box_v2(hit, rtree->box + k) > best.distance) {
+            continue;
+        }
+        if (k < rtree->level[1]) {
+            int j = rtree->index[k];
+            if (j > i && j < end) {
+                _synctex_id_s id = {j, _synctex_geometry_distance(geometry, j, hit)};
+                if (_synctex_geometry_closer(geometry, id, best)) {
+                    best = id;
+                }
+            }
+        } else {
+            /*  the closest child goes on top, to bound the others sooner */
+            int first = rtree->index[k];
+            int child = _synctex_rtree_children_end(rtree, k);
+            int closest = top;
+            int d = INT_MAX;
+            while (child > first) {
+                int dd = _synctex_distance_to_box_v2(hit, rtree->box + --child);
+                if (dd <= d) {
+                    d = dd;
+                    closest = top;
+                }
+                stack[top++] = child;
+            }
+            child = stack[closest];
+            stack[closest] = stack[top - 1];
+            stack[top - 1] = child;
+        }
+    }
+    return best;
+}
+/*  Same as __synctex_closest_deep_child_v2 for the node at index i.
+ */
+static _synctex_nd_s _synctex_geometry_closest_deep_child(_synctex_geometry_p geometry, synctex_point_p hit, int i)
+{
+    _synctex_id_s id = _synctex_geometry_closest_leaf(geometry, hit, i);
+    if (id.index < 0) {
+        /*  Only boxes and nodes at infinite distance, scan them all */
+        id = __synctex_geometry_closest_deep_child(geometry, hit, i);
+    }
+    return (_synctex_nd_s){id.index < 0 ? NULL : geometry->node[id.index], id.distance};
+}
+/*  An entry of the queue of _synctex_geometry_nearest_leaves:
+ *  the node k of the leaf index and its distance,
+ *  exact for a leaf, a lower bound otherwise.
+ */
+typedef struct {
+    int distance;
+    int k;
+} _synctex_dk_s;
+
+/*  The order of the queue: by distance, the nodes before the leaves
+ *  such that the leaves come out in order, then the leaves in preorder.
+ */
+static SYNCTEX_INLINE synctex_bool_t _synctex_dk_less(_synctex_rtree_s *rtree, _synctex_dk_s l, _synctex_dk_s r)
+{
+    synctex_bool_t l_leaf, r_leaf;
+    if (l.distance != r.distance) {
+        return l.distance < r.distance;
+    }
+    l_leaf = l.k < rtree->level[1];
+    r_leaf = r.k < rtree->level[1];
+    if (l_leaf != r_leaf) {
+        return r_leaf;
+    }
+    return l_leaf ? rtree->index[l.k] < rtree->index[r.k] : l.k < r.k;
+}
+/*  The leaves closest to the hit point with different tags or lines,
+ *  best first search in the leaf index.
+ *  found is an array of k integers.
+ *  - returns: the number of leaves, their indices
+ *      are stored in found by increasing distance,
+ *      -1 on allocation failure.
+ */
+static int _synctex_geometry_nearest_leaves(_synctex_geometry_p geometry, synctex_point_p hit, int k, int *found)
+{
+    _synctex_rtree_s *rtree = &geometry->leaf_tree;
+    _synctex_dk_s buffer[SYNCTEX_RTREE_FOUND_MAX];
+    _synctex_dk_s *heap = buffer;
+    int capacity = SYNCTEX_RTREE_FOUND_MAX;
+    /*  The leaves already found by tag and line, open addressing, -1 if free.
+     *  At most half full. */
+    int seen_buffer[2 * SYNCTEX_RTREE_FOUND_MAX];
+    int *seen = seen_buffer;
+    unsigned int mask = 2 * SYNCTEX_RTREE_FOUND_MAX - 1;
+    int size = 0;
+    int count = 0;
+    if (rtree->levels == 0) {
+        return 0;
+    }
+    while (mask < 2 * (unsigned int)k - 1) {
+        mask = 2 * mask + 1;
+    }
+    if (mask >= 2 * SYNCTEX_RTREE_FOUND_MAX && NULL == (seen = _synctex_malloc((mask + 1) * sizeof(int)))) {
+        return -1;
+    }
+    memset(seen, 0xFF, (mask + 1) * sizeof(int));
+    heap[size++] = (_synctex_dk_s){_synctex_distance_to_box_v2(hit, rtree->box + rtree->level[rtree->levels] - 1), rtree->level[rtree->levels] - 1};
+    while (size > 0 && count < k) {
+        _synctex_dk_s top = heap[0];
+        int parent = 0;
+        int child;
+        /*  pop */
+        heap[0] = heap[--size];
+        while ((child = 2 * parent + 1) < size) {
+            _synctex_dk_s dk;
+            if (child + 1 < size && _synctex_dk_less(rtree, heap[child + 1], heap[child])) {
+                ++child;
+            }
+            if (!_synctex_dk_less(rtree, heap[child], heap[parent])) {
+                break;
+            }
+            dk = heap[child];
+            heap[child] = heap[parent];
+            heap[parent] = dk;
+            parent = child;
+        }
+        if (top.k < rtree->level[1]) {
+            int i = rtree->index[top.k];
+            int tag = geometry->tag[i];
+            int line = geometry->line[i];
+            unsigned int j = _synctex_friend_hash(tag, line) & mask;
+            while (seen[j] >= 0 && (geometry->tag[seen[j]] != tag || geometry->line[seen[j]] != line)) {
+                j = (j + 1) & mask;
+            }
+            if (seen[j] < 0) {
+                seen[j] = i;
+                found[count++] = i;
+            }
+        } else {
+            int first = rtree->index[top.k];
+            int end = _synctex_rtree_children_end(rtree, top.k);
+            if (size + SYNCTEX_RTREE_FANOUT > capacity) {
+                _synctex_dk_s *more = _synctex_malloc(2 * capacity * sizeof(_synctex_dk_s));
+                if (NULL == more) {
+                    count = -1;
+                    break;
+                }
+                memcpy(more, heap, size * sizeof(_synctex_dk_s));
+                if (heap != buffer) {
+                    _synctex_free(heap);
+                }
+                heap = more;
+                capacity *= 2;
+            }
+            for (; first < end; ++first) {
+                _synctex_dk_s dk = {0, first};
+                /*  push */
+                dk.distance = first < rtree->level[1] ? _synctex_geometry_distance(geometry, rtree->index[first], hit) : _synctex_distance_to_box_v2(hit, rtree->box + first);
+                child = size++;
+                while (child > 0 && _synctex_dk_less(rtree, dk, heap[parent = (child - 1) / 2])) {
+                    heap[child] = heap[parent];
+                    child = parent;
+                }
+                heap[child] = dk;
+            }
+        }
+    }
+    if (heap != buffer) {
+        _synctex_free(heap);
+    }
+    if (seen != seen_buffer) {
+        _synctex_free(seen);
+    }
+    return count;
+}
+
 /**
  *  Return the closest child.
  *  - parameter: a pointer to the hit point,
@@ -9395,6 +13454,15 @@ static synctex_node_p _synctex_node_next(synctex_node_p node)
     }
     return _synctex_node_sibling_or_parents(node);
 }
+/*  Forget all the nodes.
+ */
+static void _synctex_directory_reset(_synctex_directory_s *directory)
+{
+    free(directory->nodes);
+    free(directory->entries);
+    free(directory->geometries);
+    memset(directory, 0, sizeof(_synctex_directory_s));
+}
 static int _synctex_input_copy_name(synctex_node_p input, char *name)
 {
     char *copy = _synctex_malloc(strlen(name) + 1);
@@ -9409,17 +13477,21 @@ int synctex_test_setup_scanner_sheets_421(synctex_scanner_p scanner)
     _synctex_data_set_page(sheet, 4);
     SYNCTEX_TEST_BODY(TC, _synctex_data_page(sheet) == 4, "");
     _synctex_node_free(scanner->sheet);
-    scanner->sheet = sheet;
+    _synctex_directory_reset(&scanner->sheet_by_page);
+    scanner->sheet = scanner->sheet_by_page.last = sheet;
+    _synctex_directory_add(&scanner->sheet_by_page, 4, sheet, synctex_YES);
     sheet = synctex_node_new(scanner, synctex_node_type_sheet);
     _synctex_data_set_page(sheet, 2);
     SYNCTEX_TEST_BODY(TC, _synctex_data_page(sheet) == 2, "");
     __synctex_tree_set_sibling(sheet, scanner->sheet);
     scanner->sheet = sheet;
+    _synctex_directory_add(&scanner->sheet_by_page, 2, sheet, synctex_YES);
     sheet = synctex_node_new(scanner, synctex_node_type_sheet);
     _synctex_data_set_page(sheet, 1);
     SYNCTEX_TEST_BODY(TC, _synctex_data_page(sheet) == 1, "");
     __synctex_tree_set_sibling(sheet, scanner->sheet);
     scanner->sheet = sheet;
+    _synctex_directory_add(&scanner->sheet_by_page, 1, sheet, synctex_YES);
     return TC;
 }
 int synctex_test_input(synctex_scanner_p scanner)
@@ -9504,7 +13576,9 @@ int synctex_test_setup_scanner_input(synctex_scanner_p scanner)
     _synctex_input_copy_name(input, "21");
     _synctex_data_set_line(input, 421);
     _synctex_node_free(scanner->input);
+    _synctex_directory_reset(&scanner->input_by_tag);
     scanner->input = input;
+    _synctex_directory_add(&scanner->input_by_tag, 4, input, synctex_YES);
     SYNCTEX_TEST_BODY(TC, _synctex_data_tag(input) == 4, "");
     SYNCTEX_TEST_BODY(TC, strcmp(_synctex_data_name(input), "21") == 0, "");
     SYNCTEX_TEST_BODY(TC, _synctex_data_line(input) == 421, "");
@@ -119,6 +119,46 @@ typedef _synctex_scanner_s *synctex_scanner_p;
  */
 synctex_scanner_p synctex_scanner_new_with_output_file(const char *output, const char *build_directory, int parse);
 
+/**
+ * @brief Parse options of one scanner.
+ *
+ *  Unlike `synctex_parse_int_policy`, they do not change
+ *  any process wide state, such that different threads
+ *  can create and parse different scanners at the same time.
+ *  Floats are always parsed independently of the locale.
+ */
+typedef struct synctex_parse_options_t {
+    /** The decimal integer parser, one of the
+     *  `synctex_parse_int_policy_t` values declared in
+     *  `synctex_parser_utils.h`, 0 for `strtol`. */
+    int int_policy;
+    /** The number of threads parsing the content of the pages,
+     *  0 or 1 to parse it on the calling thread.
+     *  Compressed files are then read into memory at once.
+     *  Without thread support, the content is parsed
+     *  on the calling thread. */
+    int threads;
+    /** When not 0, a compressed file is inflated by another
+     *  thread while the calling thread parses it.
+     *  Ignored when the content is parsed on several threads,
+     *  or without thread support. */
+    int pipeline;
+} synctex_parse_options_s;
+
+/**
+ * @brief Create a new synctex scanner with parse options.
+ *
+ *  Like `synctex_scanner_new_with_output_file`.
+ *
+ * @param options can be NULL to use the default options,
+ *      the integer policy is then the last one given
+ *      to `synctex_parse_int_policy`.
+ *      Options are copied, they are not retained.
+ * @return synctex_scanner_p NULL is returned in case
+ *      of an error or non existent file.
+ */
+synctex_scanner_p synctex_scanner_new_with_options(const char *output, const char *build_directory, int parse, const synctex_parse_options_s *options);
+
 /**
  * @brief Scanner destructor
  *
@@ -154,6 +194,48 @@ int synctex_scanner_free(synctex_scanner_p scanner);
  */
 synctex_scanner_p synctex_scanner_parse(synctex_scanner_p scanner);
 
+/**
+ * @brief Ask the scanner to parse the .synctex file lazily.
+ *
+ *  Like `synctex_scanner_parse`, but the content of the sheets
+ *  is only located in a first fast pass.
+ *  Inputs and forms are parsed at once, a sheet is parsed
+ *  the first time it is needed, either by `synctex_sheet`,
+ *  an edit query for its page or a display query,
+ *  which needs all the sheets.
+ *  The synctex file remains open until all the sheets are parsed.
+ *  Use `synctex_scanner_new_with_output_file` with 0 as parse argument,
+ *  then this function.
+ *
+ * @param scanner
+ * @return synctex_scanner_p the argument on success.
+ *      On failure, frees scanner and returns NULL.
+ */
+synctex_scanner_p synctex_scanner_parse_lazily(synctex_scanner_p scanner);
+
+/**
+ * @brief Prepare the scanner for concurrent queries.
+ *
+ *  Parse the scanner if necessary, then do at once all the work
+ *  that queries otherwise do on demand: parse the sheets skipped
+ *  by a lazy parse, create the proxies to the forms, index
+ *  the input names and lines and build the geometry of all the pages.
+ *  Afterwards, neither the queries of the iterator API
+ *  exposed in the `synctex_parser_advanced.h` header
+ *  nor the node accessors modify the scanner or its nodes:
+ *  several threads can run these queries at the same time
+ *  without locking, each thread owning the iterators it creates.
+ *  `synctex_display_query` and `synctex_edit_query` store
+ *  their results in the scanner, they are not reentrant.
+ *  The scanner must be freed after all the iterators.
+ *
+ * @param scanner
+ * @return synctex_scanner_p the argument on success.
+ *      On failure, like when parsing fails or memory is missing,
+ *      frees scanner and returns NULL.
+ */
+synctex_scanner_p synctex_scanner_freeze(synctex_scanner_p scanner);
+
 /** @} */
 
 /*  synctex_node_p is the type for all synctex nodes.
@@ -248,7 +248,8 @@ enum {
     synctex_data_input_tag_idx = 0,
     synctex_data_input_line_idx = 1,
     synctex_data_input_name_idx = 2,
-    synctex_data_input_tln_max = 3,
+    /*  the name is a pointer, it takes 2 slots */
+    synctex_data_input_tln_max = 4,
     /* sheet */
     synctex_data_sheet_page_idx = 0,
     synctex_data_p_sheet_max = 1,
@@ -323,13 +324,20 @@ typedef _synctex_class_s *synctex_class_p;
  *  synctex information. Both will depend on the type of the node,
  *  thus different nodes will have different private data.
  *  There is no inheritancy overhead.
+ *  Data slots are 32 bits wide, even on 64 bits architectures:
+ *  links to other nodes are stored as indices in the node arena
+ *  of the scanner, 0 standing for NULL.
  */
 
+/**
+ * @brief Index of a node in the arena of its scanner.
+ *
+ */
+typedef unsigned int synctex_index_t;
+
 typedef union {
-    synctex_node_p as_node;
+    synctex_index_t as_index;
     int as_integer;
-    char *as_string;
-    void *as_pointer;
 } _synctex_data_u;
 
 /**
@@ -352,14 +360,34 @@ synctex_node_p synctex_scanner_handle(synctex_scanner_p scanner);
 #define SYNCTEX_DECLARE_CHARINDEX
 #define SYNCTEX_DECLARE_CHAR_OFFSET
 #endif
+/*  The largest page and number of friends cached in a node,
+ *  0 is recorded instead of larger values. */
+#define SYNCTEX_NODE_PAGE_MAX ((1 << 19) - 1)
+#define SYNCTEX_NODE_FRIENDS_MAX ((1 << 12) - 1)
+/*  The fields of all the nodes, before their data:
+ *  - class_: each node has an associate class.
+ *  - index: the index of the node in the arena, never 0.
+ *  - page: the page of the sheet enclosing the node, -1 in a form,
+ *      0 when not known, the tree is then climbed.
+ *  - friends: the number of friends of the node among the children of its parent,
+ *      itself included, 0 when not known, they are then counted.
+ *  page and friends share 32 bits.
+ */
+#define SYNCTEX_DECLARE_NODE_HEADER                                                                                                                            \
+    SYNCTEX_DECLARE_CHARINDEX                                                                                                                                  \
+    synctex_class_p class_;                                                                                                                                    \
+    synctex_index_t index;                                                                                                                                     \
+    signed int page : 20;                                                                                                                                      \
+    unsigned int friends : 12;
 /**
  * @brief Node data model.
  *
+ *  Since version 1.32, the layout of the nodes is not the one of the previous versions:
+ *  data slots are 32 bits wide, links are arena indices and the header has more fields.
+ *  Code depending on this structure or on `_synctex_data_u` must be rebuilt.
  */
 struct _synctex_node_t {
-    SYNCTEX_DECLARE_CHARINDEX
-    /** Each node has an associate class. */
-    synctex_class_p class_;
+    SYNCTEX_DECLARE_NODE_HEADER
 #ifdef DEBUG
     _synctex_data_u data[22];
 #else
@@ -412,6 +440,28 @@ typedef struct {
  */
 typedef synctex_box_s *synctex_box_p;
 
+/**
+ * @brief Rectangle of a page, in page coordinates.
+ * Used for the answers to display range queries.
+ */
+typedef struct {
+    /** Page number, from 1. */
+    int page;
+    /** Horizontal coordinate of the top left corner. */
+    float h;
+    /** Vertical coordinate of the top left corner. */
+    float v;
+    /** Width. */
+    float width;
+    /** Height. */
+    float height;
+} synctex_rect_s;
+
+/**
+ * @brief Pointer to a page rectangle.
+ */
+typedef synctex_rect_s *synctex_rect_p;
+
 /**
  * @brief Types of the synctex nodes.
  *
@@ -563,6 +613,8 @@ void synctex_scanner_set_display_switcher(synctex_scanner_p scanR, int switcher)
 /** @defgroup Iterator Managing the answer to queries.
  *
  * Answers to edit and view queries are special structure.
+ * Once the scanner is frozen by `synctex_scanner_freeze`,
+ * iterators can be created, used and freed concurrently by different threads.
  * @{
  */
 
@@ -601,6 +653,31 @@ typedef synctex_iterator_s *synctex_iterator_p;
  * ```
  */
 synctex_iterator_p synctex_iterator_new_display(synctex_scanner_p scanner, const char *name, int line, int column, int page_hint);
+/**
+ * Designated creator for a display range query.
+ *
+ * A display range query highlights in the output a range of lines of the given input,
+ * for example a paragraph or an environment.
+ * The visible boxes of the nodes of all these lines are merged,
+ * page by page and column by column,
+ * into rectangles obtained with `synctex_iterator_next_rect`.
+ * The results are ordered by page, then from top to bottom.
+ * `synctex_iterator_next_result` returns the top box of each rectangle.
+ *
+ * Returns NULL if the query has no answer.
+ * Code example:
+ * ```
+ *    synctex_iterator_p iterator = NULL;
+ *    if ((iterator = synctex_iterator_new_display_range(...)) {
+ *      synctex_rect_s rect;
+ *      while(synctex_iterator_next_rect(iterator, &rect)) {
+ *        <do something with rect...>
+ *      }
+ *      synctex_iterator_free(iterator);
+ *    }
+ * ```
+ */
+synctex_iterator_p synctex_iterator_new_display_range(synctex_scanner_p scanner, const char *name, int first_line, int last_line);
 /**
  *  Designated creator for an  edit query.
  *
@@ -618,6 +695,27 @@ synctex_iterator_p synctex_iterator_new_display(synctex_scanner_p scanner, const
  * ```
  */
 synctex_iterator_p synctex_iterator_new_edit(synctex_scanner_p scanner, int page, float h, float v);
+/**
+ *  Designated creator for a k nearest edit query.
+ *
+ *  The results are the nodes of the given page closest to the point (h, v),
+ *  by increasing distance, one per source location:
+ *  a node is skipped when a closer one has the same tag and line.
+ *  There are at most k results, fewer when the page has not enough locations.
+ *  Boxes are not results, only the nodes they contain.
+ *  Used like synctex_iterator_new_edit.
+ */
+synctex_iterator_p synctex_iterator_new_edit_knn(synctex_scanner_p scanner, int page, float h, float v, int k);
+/**
+ *  Designated creator for a region query.
+ *
+ *  The results are the nodes of the given page that intersect
+ *  the rectangle with corners (h0, v0) and (h1, v1),
+ *  one per source location, sorted by line then by tag.
+ *  A box is a result only when none of its children intersect the rectangle.
+ *  Used like synctex_iterator_new_edit.
+ */
+synctex_iterator_p synctex_iterator_new_region(synctex_scanner_p scanner, int page, float h0, float v0, float h1, float v1);
 
 /*
  *
@@ -654,6 +752,19 @@ synctex_bool_t synctex_iterator_has_next(synctex_iterator_p iterator);
  */
 synctex_node_p synctex_iterator_next_result(synctex_iterator_p iterator);
 
+/**
+ * @brief Get the rectangle of the next query result.
+ *
+ * Only display range queries have rectangles.
+ * Copies the rectangle of the pointed result into rect
+ * and advance the cursor like `synctex_iterator_next_result`.
+ *
+ * @param iterator the object to iterate on...
+ * @param rect the rectangle to fill
+ * @return synctex_bool_t whether rect was filled
+ */
+synctex_bool_t synctex_iterator_next_rect(synctex_iterator_p iterator, synctex_rect_p rect);
+
 /**
  * @brief Reset the cursor position to the first result.
  *
@@ -48,6 +48,8 @@
 
 #include <ctype.h>
 #include <limits.h>
+#include <math.h>
+#include <stdint.h>
 
 #include <sys/stat.h>
 
@@ -275,6 +277,27 @@ next_character:
     goto next_character;
 }
 
+/*  FNV-1a over the characters compared by _synctex_is_equivalent_file_name */
+unsigned int _synctex_file_name_hash(const char *name)
+{
+    unsigned int hash = 2166136261u;
+    synctex_ignore_leading_dot_slash_in_path(&name);
+    while (*name) {
+        unsigned char c = (unsigned char)*name++;
+        if (SYNCTEX_IS_PATH_SEPARATOR(c)) {
+            c = '/';
+            synctex_ignore_leading_dot_slash_in_path(&name);
+        }
+#if !SYNCTEX_CASE_SENSITIVE_PATH
+        else {
+            c = (unsigned char)toupper(c);
+        }
+#endif
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
 synctex_bool_t _synctex_path_is_absolute(const char *name)
 {
     if (!strlen(name)) {
@@ -556,8 +579,6 @@ const char *_synctex_get_io_mode_name(synctex_io_mode_t io_mode)
     return synctex_io_modes[index];
 }
 
-typedef int (*synctex_parse_int_f)(char *ptr, char **endptr);
-
 static int _synctex_parse_int_C(char *ptr, char **endptr)
 {
     return (int)strtol(ptr, endptr, 10);
@@ -641,39 +662,232 @@ will_return:
     return negative ? -result : result;
 }
 
+synctex_parse_int_f synctex_parse_int_function(synctex_parse_int_policy_t policy)
+{
+    if (policy == synctex_parse_int_policy_request || policy == synctex_parse_int_policy_raw1) {
+        return &_synctex_parse_int_raw1;
+    } else if (policy == synctex_parse_int_policy_raw2) {
+        return &_synctex_parse_int_raw2;
+    }
+    return &_synctex_parse_int_C;
+}
+
 static synctex_parse_int_f synctex_parse_int_do = &_synctex_parse_int_C;
 
 synctex_parse_int_policy_t synctex_parse_int_policy(synctex_parse_int_policy_t policy)
 {
-    if (policy == synctex_parse_int_policy_request) {
-        if ((synctex_parse_int_do = &_synctex_parse_int_raw1)) {
-            return synctex_parse_int_policy_raw1;
-        }
-        if ((synctex_parse_int_do = &_synctex_parse_int_raw2)) {
-            return synctex_parse_int_policy_raw2;
-        }
-        return synctex_parse_int_policy_C;
-    } else if (policy == synctex_parse_int_policy_raw1) {
+    synctex_parse_int_do = synctex_parse_int_function(policy);
+    if (synctex_parse_int_do == &_synctex_parse_int_raw1) {
 #if SYNCTEX_DEBUG > 500
         printf("synctex_parse_int_policy: raw1");
 #endif
-        synctex_parse_int_do = &_synctex_parse_int_raw1;
-    } else if (policy == synctex_parse_int_policy_raw2) {
+        return synctex_parse_int_policy_raw1;
+    } else if (synctex_parse_int_do == &_synctex_parse_int_raw2) {
 #if SYNCTEX_DEBUG > 500
         printf("synctex_parse_int_policy: raw2");
 #endif
-        synctex_parse_int_do = &_synctex_parse_int_raw2;
-    } else {
+        return synctex_parse_int_policy_raw2;
+    }
 #if SYNCTEX_DEBUG > 500
-        printf("synctex_parse_int_policy: C");
+    printf("synctex_parse_int_policy: C");
 #endif
-        synctex_parse_int_do = &_synctex_parse_int_C;
-        return synctex_parse_int_policy_C;
-    }
-    return policy;
+    return synctex_parse_int_policy_C;
+}
+
+synctex_parse_int_f synctex_parse_int_default(void)
+{
+    return synctex_parse_int_do;
 }
 
 int synctex_parse_int(char *ptr, char **endptr)
 {
     return (*synctex_parse_int_do)(ptr, endptr);
 }
+
+/*  The powers of ten that are exactly represented by a double. */
+static const double _synctex_exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+/*  Up to 19 significant digits are accumulated in an integer mantissa.
+ *  When the mantissa and the power of ten are both exact doubles,
+ *  one multiplication or division gives the correctly rounded result, like strtod.
+ *  Otherwise the scaling is done in long double. */
+double synctex_parse_float(char *ptr, char **endptr)
+{
+    char *start = ptr;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    synctex_bool_t seen = synctex_NO;
+    synctex_bool_t negative = synctex_NO;
+    long double value;
+    while (*ptr == ' ' || (*ptr >= '\t' && *ptr <= '\r')) {
+        ++ptr;
+    }
+    if (*ptr == '-' || *ptr == '+') {
+        negative = *ptr++ == '-';
+    }
+    for (; *ptr >= '0' && *ptr <= '9'; ++ptr) {
+        seen = synctex_YES;
+        if (digits < 19) {
+            mantissa = 10 * mantissa + (*ptr - '0');
+            digits += mantissa > 0;
+        } else {
+            ++exponent;
+        }
+    }
+    if (*ptr == '.') {
+        for (++ptr; *ptr >= '0' && *ptr <= '9'; ++ptr) {
+            seen = synctex_YES;
+            if (digits < 19) {
+                mantissa = 10 * mantissa + (*ptr - '0');
+                digits += mantissa > 0;
+                --exponent;
+            }
+        }
+    }
+    if (!seen) {
+        if (endptr) {
+            *endptr = start;
+        }
+        return 0;
+    }
+    if (*ptr == 'e' || *ptr == 'E') {
+        char *e = ptr + 1;
+        synctex_bool_t negative_e = synctex_NO;
+        int n = 0;
+        if (*e == '-' || *e == '+') {
+            negative_e = *e++ == '-';
+        }
+        if (*e >= '0' && *e <= '9') {
+            for (; *e >= '0' && *e <= '9'; ++e) {
+                if (n < 10000) {
+                    n = 10 * n + (*e - '0');
+                }
+            }
+            exponent += negative_e ? -n : n;
+            ptr = e;
+        }
+    }
+    if (endptr) {
+        *endptr = ptr;
+    }
+    if (mantissa == 0) {
+        return negative ? -0.0 : 0.0;
+    }
+    if (mantissa <= (UINT64_C(1) << 53) && exponent >= -22 && exponent <= 22) {
+        double d = (double)mantissa;
+        d = exponent < 0 ? d / _synctex_exact_powers_of_ten[-exponent] : d * _synctex_exact_powers_of_ten[exponent];
+        return negative ? -d : d;
+    }
+    value = mantissa;
+    if (exponent > 400) {
+        value = HUGE_VAL;
+    } else if (exponent < -400) {
+        value = 0;
+    } else {
+        for (; exponent > 22; exponent -= 22) {
+            value *= 1e22L;
+        }
+        for (; exponent < -22; exponent += 22) {
+            value /= 1e22L;
+        }
+        value = exponent < 0 ? value / _synctex_exact_powers_of_ten[-exponent] : value * _synctex_exact_powers_of_ten[exponent];
+    }
+    return (double)(negative ? -value : value);
+}
+
+/*  Record fields are decoded 8 digits at a time on little endian machines:
+ *  the digits are loaded in one 64 bits word and converted with 3 multiplications.
+ *  Define SYNCTEX_USE_SWAR to 0 to use the byte by byte loop instead. */
+#if !defined(SYNCTEX_USE_SWAR)
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SYNCTEX_USE_SWAR 1
+#else
+#define SYNCTEX_USE_SWAR 0
+#endif
+#endif
+
+#if SYNCTEX_USE_SWAR
+/*  Converts the leading digits of the 8 bytes at ptr.
+ *  - returns: the number of digits, the value is set only when this is positive. */
+static int _synctex_parse_digits_swar(const char *ptr, unsigned *value)
+{
+    uint64_t word, nondigits;
+    int n;
+    memcpy(&word, ptr, sizeof(word));
+    word ^= 0x3030303030303030ULL;
+    /*  The high bit of a byte is set when it is not a digit.
+     *  The carries only spoil the bytes after the first non digit. */
+    nondigits = (word | (word + 0x7676767676767676ULL)) & 0x8080808080808080ULL;
+    n = nondigits ? __builtin_ctzll(nondigits) >> 3 : 8;
+    if (n) {
+        word <<= 8 * (8 - n);
+        word = ((word & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+        word = ((word & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+        *value = (unsigned)(((word & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32);
+    }
+    return n;
+}
+#endif
+
+/*  Parses one signed decimal integer, with no leading space.
+ *  Integers with more than 8 digits are left to parse_int
+ *  such that overflows are managed by its policy.
+ *  - returns: the end of the integer or NULL if there is none at ptr. */
+static char *_synctex_parse_int_field(synctex_parse_int_f parse_int, char *ptr, char *end, int *value)
+{
+    char *start = ptr;
+    synctex_bool_t negative = (*ptr == '-');
+    unsigned result = 0;
+    int n = 0;
+    if (negative || *ptr == '+') {
+        ptr++;
+    }
+#if SYNCTEX_USE_SWAR
+    if (end - ptr >= 8) {
+        n = _synctex_parse_digits_swar(ptr, &result);
+    } else
+#endif
+    {
+        while (n < 8 && ptr[n] >= '0' && ptr[n] <= '9') {
+            result = 10 * result + (ptr[n] - '0');
+            n++;
+        }
+    }
+    if (n == 0) {
+        return NULL;
+    }
+    if (n < 8 || ptr[n] < '0' || ptr[n] > '9') {
+        *value = negative ? -(int)result : (int)result;
+        return ptr + n;
+    }
+    *value = (*parse_int)(start, &ptr);
+    return ptr;
+}
+
+int synctex_parse_int_fields(synctex_parse_int_f parse_int, char *ptr, char *end, int *values, char *separators, int count, char **endptr)
+{
+    int i = 0;
+    if (NULL == parse_int) {
+        parse_int = &synctex_parse_int;
+    }
+    while (i < count && ptr < end) {
+        char *field = ptr;
+        char separator = 0;
+        if (*ptr == ':' || *ptr == ',') {
+            separator = *ptr++;
+        }
+        if (!(ptr = _synctex_parse_int_field(parse_int, ptr, end, values + i))) {
+            ptr = field;
+            break;
+        }
+        separators[i++] = separator;
+    }
+    if (endptr) {
+        *endptr = ptr;
+    }
+    return i;
+}
@@ -121,6 +121,9 @@ void _synctex_strip_last_path_extension(char *string);
  *  It is 0 otherwise. */
 synctex_bool_t _synctex_is_equivalent_file_name(const char *lhs, const char *rhs);
 
+/*  A hash of the file name such that equivalent file names have the same hash. */
+unsigned int _synctex_file_name_hash(const char *name);
+
 /**
  * The client is responsible of the management of the returned string, if any.
  */
@@ -179,10 +182,41 @@ typedef enum {
     synctex_parse_int_policy_raw2 = 2,
 } synctex_parse_int_policy_t;
 
+typedef int (*synctex_parse_int_f)(char *ptr, char **endptr);
+
+/*  Sets the policy of synctex_parse_int,
+ *  which is also the default one of the scanners created afterwards.
+ *  Scanners created with options keep their own policy. */
 synctex_parse_int_policy_t synctex_parse_int_policy(synctex_parse_int_policy_t policy);
 
+/*  Returns the decimal integer parser of the given policy, without changing the default one. */
+synctex_parse_int_f synctex_parse_int_function(synctex_parse_int_policy_t policy);
+
+/*  Returns the decimal integer parser of the current policy. */
+synctex_parse_int_f synctex_parse_int_default(void);
+
 int synctex_parse_int(char *ptr, char **endptr);
 
+/*  Parses a decimal float like strtod does in the "C" locale, whatever the current locale.
+ *  Leading spaces, an optional sign, digits with an optional '.' fraction and an optional exponent.
+ *  Hexadecimal floats, infinities and NaN are not recognized.
+ *  Unlike setlocale and strtod, it can be used by several threads at the same time. */
+double synctex_parse_float(char *ptr, char **endptr);
+
+/*  Parses the integer fields of a record like `tag,line:h,v:w,h,d` in one call.
+ *  Each field is an optional ':' or ',' separator followed by a signed decimal integer.
+ *  Parsing stops at the first field that is not an integer, like `,=`.
+ *  - argument parse_int: parses the integers with more than 8 digits,
+ *      such that overflows are managed by its policy, synctex_parse_int if NULL.
+ *  - argument ptr: the first field.
+ *  - argument end: the terminating character, not a digit, all the bytes in [ptr, end] are readable.
+ *  - argument values: receives the integers, at least count of them.
+ *  - argument separators: receives the separators, 0 when there is none.
+ *  - argument endptr: receives the end of the last parsed field, may be NULL.
+ *  - returns: the number of parsed fields.
+ */
+int synctex_parse_int_fields(synctex_parse_int_f parse_int, char *ptr, char *end, int *values, char *separators, int count, char **endptr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,148 @@
+// Run display and edit queries from several threads on a frozen scanner.
+// Each thread runs all the queries and checks their results
+// against a single threaded reference pass.
+// Usage: bench_concurrent_queries output.pdf [maximum number of threads]
+// The synctex file next to the output file is used.
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <synctex_parser_advanced.h>
+
+#include "bench_nodes.h"
+
+typedef struct {
+	synctex_scanner_p scanner;
+	bench_node_s * queries;
+	unsigned long * expected;
+	long count;
+	long mismatches;
+} job_s;
+
+/* Result handles are owned by each iterator: hash what they point to */
+static unsigned long hash_results(synctex_iterator_p iterator) {
+	unsigned long hash = 5381;
+	synctex_node_p node;
+	if (!iterator) {
+		return 0;
+	}
+	while ((node = synctex_iterator_next_result(iterator))) {
+		hash = 33 * hash + (unsigned long)synctex_node_page(node);
+		hash = 33 * hash + (unsigned long)synctex_node_tag(node);
+		hash = 33 * hash + (unsigned long)synctex_node_line(node);
+		hash = 33 * hash + (unsigned long)synctex_node_h(node);
+		hash = 33 * hash + (unsigned long)synctex_node_v(node);
+	}
+	synctex_iterator_free(iterator);
+	return hash;
+}
+
+static unsigned long run_display(synctex_scanner_p scanner, bench_node_s * query) {
+	const char * name = synctex_scanner_get_name(scanner, query->tag);
+	return hash_results(synctex_iterator_new_display(scanner, name, query->line, 0, -1));
+}
+
+static unsigned long run_edit(synctex_scanner_p scanner, bench_node_s * query) {
+	return hash_results(synctex_iterator_new_edit(scanner, query->page, query->h, query->v));
+}
+
+static void * run_job(void * arg) {
+	job_s * job = arg;
+	long i;
+	for (i = 0; i < job->count; ++i) {
+		if (run_display(job->scanner, job->queries + i) != job->expected[2 * i]) {
+			++job->mismatches;
+		}
+		if (run_edit(job->scanner, job->queries + i) != job->expected[2 * i + 1]) {
+			++job->mismatches;
+		}
+	}
+	return NULL;
+}
+
+static double seconds_since(struct timespec * start) {
+	struct timespec stop;
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	return (stop.tv_sec - start->tv_sec) + (stop.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char ** argv) {
+	synctex_scanner_p scanner;
+	bench_node_s * queries;
+	unsigned long * expected;
+	job_s jobs[64];
+	pthread_t threads[64];
+	struct timespec start;
+	double single = 0;
+	long count = 0, i;
+	int maximum = argc > 2 ? atoi(argv[2]) : 8;
+	int failed = 0;
+	int n, t;
+	if (argc < 2) {
+		printf("Usage: %s output.pdf [maximum number of threads]\n", argv[0]);
+		return 0;
+	}
+	maximum = maximum < 1 ? 1 : maximum > 64 ? 64 : maximum;
+	if (!(scanner = synctex_scanner_new_with_output_file(argv[1], NULL, 1))) {
+		printf("%s: no synctex file\n", argv[1]);
+		return 1;
+	}
+	if (!synctex_scanner_freeze(scanner)) {
+		printf("%s: the scanner can't be frozen\n", argv[1]);
+		return 1;
+	}
+	if (!(queries = bench_collect_nodes(scanner, &count))
+			|| !(expected = malloc(2 * (count + 1) * sizeof(unsigned long)))) {
+		free(queries);
+		synctex_scanner_free(scanner);
+		return 1;
+	}
+	/* One query per distinct tag and line, the position of the node is used for the edit query */
+	count = bench_distinct_nodes(queries, count);
+	for (i = 0; i < count; ++i) {
+		expected[2 * i] = run_display(scanner, queries + i);
+		expected[2 * i + 1] = run_edit(scanner, queries + i);
+	}
+	printf("%s\n  %ld display and %ld edit queries per thread\n", argv[1], count, count);
+	for (n = 1; n <= maximum; n *= 2) {
+		long mismatches = 0;
+		double elapsed;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (t = 0; t < n; ++t) {
+			jobs[t].scanner = scanner;
+			jobs[t].queries = queries;
+			jobs[t].expected = expected;
+			jobs[t].count = count;
+			jobs[t].mismatches = 0;
+			if (pthread_create(threads + t, NULL, run_job, jobs + t)) {
+				printf("X thread %i can't be created\n", t);
+				n = t;
+				failed = 1;
+				break;
+			}
+		}
+		for (t = 0; t < n; ++t) {
+			pthread_join(threads[t], NULL);
+			mismatches += jobs[t].mismatches;
+		}
+		elapsed = seconds_since(&start);
+		if (n == 1) {
+			single = elapsed;
+		}
+		printf("  %2i threads: %10.0f queries/s, speedup %5.2f\n",
+			n, 2.0 * count * n / elapsed, elapsed > 0 ? single * n / elapsed : 0);
+		if (mismatches) {
+			printf("X %ld results differ from the single threaded ones\n", mismatches);
+			failed = 1;
+		}
+		if (!n) {
+			break;
+		}
+	}
+	free(expected);
+	free(queries);
+	synctex_scanner_free(scanner);
+	return failed;
+}
@@ -0,0 +1,167 @@
+// Compare the friend lists walked by display queries:
+// the former 1024 lists keyed by (tag + line) % 1024
+// against the lists keyed exactly by tag and line.
+// Both kinds of lists are built over the nodes of the scanner,
+// then walked once per distinct tag and line, counting and timing the nodes visited.
+// The display queries of the scanner, which use the exact lists, are timed too.
+// Usage: bench_friends output.pdf...
+// The synctex file next to each output file is used.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <synctex_parser.h>
+
+#include "bench_nodes.h"
+
+#define NUMBER_OF_LISTS 1024
+
+typedef struct {
+	int tag;
+	int line;
+	long index;
+} key_s;
+
+typedef struct {
+	long walked;
+	long maximum;
+	long found;
+	double seconds;
+} walk_s;
+
+static int compare_keys(const void * l, const void * r) {
+	const key_s * L = l;
+	const key_s * R = r;
+	if (L->tag != R->tag) {
+		return L->tag < R->tag ? -1 : 1;
+	}
+	if (L->line != R->line) {
+		return L->line < R->line ? -1 : 1;
+	}
+	return L->index < R->index ? -1 : L->index > R->index;
+}
+
+static double seconds_since(struct timespec * start) {
+	struct timespec stop;
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	return (stop.tv_sec - start->tv_sec) + (stop.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Walk the list starting at each head, like the display queries do */
+static walk_s walk(bench_node_s * nodes, long * next, long * heads, key_s * queries, long distinct) {
+	walk_s result = {0, 0, 0, 0};
+	struct timespec start;
+	long i, k;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < distinct; ++i) {
+		long walked = 0;
+		for (k = heads[i]; k >= 0; k = next[k]) {
+			++walked;
+			if (synctex_node_tag(nodes[k].node) == queries[i].tag && synctex_node_line(nodes[k].node) == queries[i].line) {
+				++result.found;
+			}
+		}
+		result.walked += walked;
+		result.maximum = walked > result.maximum ? walked : result.maximum;
+	}
+	result.seconds = seconds_since(&start);
+	return result;
+}
+
+static int bench(const char * output) {
+	synctex_scanner_p scanner = synctex_scanner_new_with_output_file(output, NULL, 1);
+	static long lists[NUMBER_OF_LISTS];
+	bench_node_s * nodes = NULL;
+	key_s * keys = NULL;
+	long * next = NULL;
+	long * heads = NULL;
+	long count = 0, distinct = 0, i;
+	long results = 0;
+	walk_s before, after;
+	struct timespec start;
+	double display;
+	int failed = 1;
+	if (!scanner) {
+		printf("%s: no synctex file\n", output);
+		return 1;
+	}
+	if (!(nodes = bench_collect_nodes(scanner, &count))
+			|| !(keys = malloc((count + 1) * sizeof(key_s)))
+			|| !(next = malloc((count + 1) * sizeof(long)))
+			|| !(heads = malloc((count + 1) * sizeof(long)))) {
+		goto bail;
+	}
+	for (i = 0; i < count; ++i) {
+		keys[i].tag = nodes[i].tag;
+		keys[i].line = nodes[i].line;
+		keys[i].index = i;
+	}
+	/* The exact lists, in document order */
+	qsort(keys, count, sizeof(key_s), compare_keys);
+	for (i = 0; i < count; ++i) {
+		if (i + 1 < count && keys[i + 1].tag == keys[i].tag && keys[i + 1].line == keys[i].line) {
+			next[keys[i].index] = keys[i + 1].index;
+		} else {
+			next[keys[i].index] = -1;
+		}
+		if (!i || keys[i - 1].tag != keys[i].tag || keys[i - 1].line != keys[i].line) {
+			heads[distinct] = keys[i].index;
+			keys[distinct++] = keys[i];
+		}
+	}
+	after = walk(nodes, next, heads, keys, distinct);
+	/* The former lists, in document order */
+	for (i = 0; i < NUMBER_OF_LISTS; ++i) {
+		lists[i] = -1;
+	}
+	for (i = count; i-- > 0;) {
+		long * head = lists + (unsigned int)(nodes[i].tag + nodes[i].line) % NUMBER_OF_LISTS;
+		next[i] = *head;
+		*head = i;
+	}
+	for (i = 0; i < distinct; ++i) {
+		heads[i] = lists[(unsigned int)(keys[i].tag + keys[i].line) % NUMBER_OF_LISTS];
+	}
+	before = walk(nodes, next, heads, keys, distinct);
+	if (before.found != after.found || after.found != count) {
+		printf("%s: the lists don't have the same nodes\n", output);
+		goto bail;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < distinct; ++i) {
+		const char * name = synctex_scanner_get_name(scanner, keys[i].tag);
+		results += synctex_display_query(scanner, name, keys[i].line, 0, -1);
+	}
+	display = seconds_since(&start);
+	printf("%s\n", output);
+	printf("  %ld nodes, %ld distinct tag and line, %ld results\n", count, distinct, results);
+	if (distinct) {
+		printf("  friends walked per query: before %8.1f (max %ld), after %8.1f (max %ld)\n",
+			(double)before.walked / distinct, before.maximum, (double)after.walked / distinct, after.maximum);
+		printf("  list walk: before %.2f us/query, after %.2f us/query\n",
+			before.seconds * 1e6 / distinct, after.seconds * 1e6 / distinct);
+		printf("  display query: %.2f us/query\n", display * 1e6 / distinct);
+	}
+	failed = 0;
+bail:
+	free(heads);
+	free(next);
+	free(keys);
+	free(nodes);
+	synctex_scanner_free(scanner);
+	return failed;
+}
+
+int main(int argc, char ** argv) {
+	int failed = 0;
+	int i;
+	if (argc < 2) {
+		printf("Usage: %s output.pdf...\n", argv[0]);
+		return 0;
+	}
+	for (i = 1; i < argc; ++i) {
+		failed |= bench(argv[i]);
+	}
+	return failed;
+}
@@ -0,0 +1,158 @@
+// Parse a synthetic synctex file where keywords straddle the boundaries
+// of the reader buffer, compressed or not, eagerly or lazily.
+// Input lines and post scriptum lines of all lengths shift the keywords
+// across the buffer, and the file ends in the middle of a keyword.
+// All the parses must give the same result, without seeking back the file.
+// Usage: bench_match_string [number of pages]
+// The synthetic files are created in the current directory, then removed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <zlib.h>
+
+#include <synctex_parser_advanced.h>
+
+#define OUTPUT "bench_match_string.pdf"
+#define SYNCTEX "bench_match_string.synctex"
+#define SYNCTEX_GZ "bench_match_string.synctex.gz"
+#define REPEAT 3
+
+typedef struct {
+	int pages;
+	int inputs;
+	float magnification;
+	float x_offset;
+	float y_offset;
+} summary_s;
+
+static double seconds_since(struct timespec * start) {
+	struct timespec stop;
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	return (stop.tv_sec - start->tv_sec) + (stop.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* Some padding of the given length */
+static const char * padding(int length) {
+	static char bytes[128];
+	memset(bytes, 'a' + length % 26, length);
+	bytes[length] = '\0';
+	return bytes;
+}
+
+static int write_synctex(const char * path, int compressed, int pages) {
+	FILE * F = NULL;
+	gzFile G = NULL;
+	char line[256];
+	int page, i;
+	if (compressed ? !(G = gzopen(path, "wb")) : !(F = fopen(path, "wb"))) {
+		return 1;
+	}
+#define WRITE(...) do {                                                                                                            \
+		int n = snprintf(line, sizeof(line), __VA_ARGS__);                                                                         \
+		if (G) gzwrite(G, line, n); else fwrite(line, 1, n, F);                                                                    \
+	} while (0)
+	WRITE("SyncTeX Version:1\n");
+	WRITE("Input:1:/synthetic/main.tex\n");
+	WRITE("Output:pdf\nMagnification:1000\nUnit:1\nX Offset:0\nY Offset:0\nContent:\n");
+	for (page = 1; page <= pages; ++page) {
+		WRITE("{%i\n", page);
+		WRITE("[1,%i:0,0:4000000,6000000,0\n", page);
+		WRITE("(1,%i:100000,%i:3000000,400000,100000\n", page, 100000 + page);
+		WRITE("x1,%i:200000,%i\n", page, 100000 + page);
+		WRITE("k1,%i:300000,%i:20000\n", page, 100000 + page);
+		WRITE(")\n]\n");
+		WRITE("}%i\n", page);
+		/* One more byte each time */
+		WRITE("Input:%i:/synthetic/%s.tex\n", page + 1, padding(page % 97));
+	}
+	WRITE("Postamble:\nCount:%i\nPost scriptum:\n", 6 * pages);
+	for (i = 0; i < 4 * 97; ++i) {
+		WRITE("Post:%s\n", padding(i % 97));
+	}
+	WRITE("Magnification:2000\nX Offset:1in\nY Offset:2cm\n");
+	/* Truncated keyword, no end of line */
+	WRITE("Post scrip");
+#undef WRITE
+	if (G) {
+		return gzclose(G) != Z_OK;
+	}
+	return fclose(F) != 0;
+}
+
+/* The best time of a few parses, 0 when the file could not be parsed */
+static double parse(int lazy, summary_s * summary) {
+	double best = 0;
+	int i;
+	for (i = 0; i < REPEAT; ++i) {
+		struct timespec start;
+		synctex_scanner_p scanner;
+		synctex_node_p node;
+		double elapsed;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		scanner = synctex_scanner_new_with_output_file(OUTPUT, NULL, !lazy);
+		if (scanner && lazy) {
+			scanner = synctex_scanner_parse_lazily(scanner);
+		}
+		if (!scanner) {
+			return 0;
+		}
+		memset(summary, 0, sizeof(summary_s));
+		/* The last page also parses all the sheets of a lazy scanner */
+		for (node = synctex_scanner_input(scanner); node; node = synctex_node_sibling(node)) {
+			++summary->inputs;
+		}
+		while (synctex_sheet(scanner, summary->pages + 1)) {
+			++summary->pages;
+		}
+		elapsed = seconds_since(&start);
+		summary->magnification = synctex_scanner_magnification(scanner);
+		summary->x_offset = synctex_scanner_x_offset(scanner);
+		summary->y_offset = synctex_scanner_y_offset(scanner);
+		synctex_scanner_free(scanner);
+		if (i == 0 || elapsed < best) {
+			best = elapsed;
+		}
+	}
+	return best;
+}
+
+/* The result of the first parse, all the others must give the same */
+static summary_s reference;
+static int has_reference = 0;
+
+static int bench(const char * path, int compressed, int pages, const char * label) {
+	summary_s summary;
+	int failed = 0;
+	int lazy;
+	if (write_synctex(path, compressed, pages)) {
+		printf("%s: can't create %s\n", label, path);
+		return 1;
+	}
+	for (lazy = 0; lazy < 2; ++lazy) {
+		double elapsed = parse(lazy, &summary);
+		int ok = elapsed > 0 && summary.pages == pages && summary.inputs == pages + 1;
+		if (ok && !has_reference) {
+			reference = summary;
+			has_reference = 1;
+		}
+		ok = ok && !memcmp(&summary, &reference, sizeof(summary_s));
+		printf("  %s, %s: %8.2f ms, %i pages, %i inputs, magnification %g, offsets %g %g%s\n", label, lazy ? "lazy " : "eager",
+			elapsed * 1e3, summary.pages, summary.inputs, summary.magnification, summary.x_offset, summary.y_offset,
+			ok ? "" : ", WRONG");
+		failed |= !ok;
+	}
+	remove(path);
+	return failed;
+}
+
+int main(int argc, char ** argv) {
+	int pages = argc > 1 && atoi(argv[1]) > 0 ? atoi(argv[1]) : 20000;
+	int failed = 0;
+	printf("%i pages, keywords at all the offsets of the buffer\n", pages);
+	failed |= bench(SYNCTEX, 0, pages, "plain     ");
+	failed |= bench(SYNCTEX_GZ, 1, pages, "compressed");
+	return failed;
+}
@@ -0,0 +1,58 @@
+// Nodes of a scanner shared by the benchmarks that run queries.
+
+#include <stdlib.h>
+
+#include "bench_nodes.h"
+
+bench_node_s * bench_collect_nodes(synctex_scanner_p scanner, long * count) {
+	long capacity = 1024;
+	bench_node_s * nodes = malloc(capacity * sizeof(bench_node_s));
+	int page;
+	synctex_node_p sheet;
+	*count = 0;
+	for (page = 1; nodes && (sheet = synctex_sheet(scanner, page)); ++page) {
+		synctex_node_p node = sheet;
+		while ((node = synctex_node_next(node))) {
+			int tag = synctex_node_tag(node);
+			if (tag > 0) {
+				if (*count == capacity) {
+					bench_node_s * more = realloc(nodes, 2 * capacity * sizeof(bench_node_s));
+					if (!more) {
+						free(nodes);
+						return NULL;
+					}
+					nodes = more;
+					capacity *= 2;
+				}
+				nodes[*count].node = node;
+				nodes[*count].tag = tag;
+				nodes[*count].line = synctex_node_line(node);
+				nodes[*count].page = page;
+				nodes[*count].h = synctex_node_visible_h(node);
+				nodes[*count].v = synctex_node_visible_v(node);
+				++*count;
+			}
+		}
+	}
+	return nodes;
+}
+
+int bench_compare_nodes(const void * l, const void * r) {
+	const bench_node_s * L = l;
+	const bench_node_s * R = r;
+	if (L->tag != R->tag) {
+		return L->tag < R->tag ? -1 : 1;
+	}
+	return L->line < R->line ? -1 : L->line > R->line;
+}
+
+long bench_distinct_nodes(bench_node_s * nodes, long count) {
+	long distinct = 0, i;
+	qsort(nodes, count, sizeof(bench_node_s), bench_compare_nodes);
+	for (i = 0; i < count; ++i) {
+		if (!distinct || bench_compare_nodes(nodes + distinct - 1, nodes + i)) {
+			nodes[distinct++] = nodes[i];
+		}
+	}
+	return distinct;
+}
@@ -0,0 +1,28 @@
+// Nodes of a scanner shared by the benchmarks that run queries.
+
+#ifndef BENCH_NODES_H
+#define BENCH_NODES_H
+
+#include <synctex_parser.h>
+
+typedef struct {
+	synctex_node_p node;
+	int tag;
+	int line;
+	int page;
+	float h;
+	float v;
+} bench_node_s;
+
+// The nodes with a tag of all the sheets, in document order.
+// The result is NULL when memory is missing, otherwise it must be freed.
+bench_node_s * bench_collect_nodes(synctex_scanner_p scanner, long * count);
+
+// The qsort comparator of the nodes by tag, then line.
+int bench_compare_nodes(const void * l, const void * r);
+
+// Sort the nodes by tag and line, then keep one node of each tag and line.
+// Returns the number of nodes kept.
+long bench_distinct_nodes(bench_node_s * nodes, long count);
+
+#endif
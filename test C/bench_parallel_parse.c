@@ -0,0 +1,119 @@
+// Parse synctex files with 1, 2, 4... threads and compare
+// the time and a checksum of the nodes against a sequential parse.
+// Usage: bench_parallel_parse output.pdf... [maximum number of threads]
+// The synctex file next to each output file is used.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <synctex_parser_advanced.h>
+
+#define REPEAT 5
+
+static double seconds_since(struct timespec * start) {
+	struct timespec stop;
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	return (stop.tv_sec - start->tv_sec) + (stop.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* A checksum of the nodes of all the sheets and of the friends of the first lines */
+static unsigned long checksum(synctex_scanner_p scanner) {
+	unsigned long sum = 0;
+	synctex_node_p sheet;
+	synctex_node_p input;
+	int page;
+	for (page = 1; (sheet = synctex_sheet(scanner, page)); ++page) {
+		synctex_node_p node = sheet;
+		while ((node = synctex_node_next(node))) {
+			sum = 31 * sum + (unsigned long)synctex_node_type(node);
+			sum = 31 * sum + (unsigned long)synctex_node_tag(node);
+			sum = 31 * sum + (unsigned long)synctex_node_line(node);
+			sum = 31 * sum + (unsigned long)synctex_node_h(node);
+			sum = 31 * sum + (unsigned long)synctex_node_v(node);
+			sum = 31 * sum + (unsigned long)synctex_node_width(node);
+		}
+	}
+	for (input = synctex_scanner_input(scanner); input; input = synctex_node_sibling(input)) {
+		const char * name = synctex_scanner_get_name(scanner, synctex_node_tag(input));
+		int line;
+		for (line = 1; line < 100; ++line) {
+			synctex_node_p result;
+			sum = 31 * sum + (unsigned long)synctex_display_query(scanner, name, line, 0, -1);
+			while ((result = synctex_scanner_next_result(scanner))) {
+				sum = 31 * sum + (unsigned long)synctex_node_page(result);
+				sum = 31 * sum + (unsigned long)synctex_node_h(result);
+				sum = 31 * sum + (unsigned long)synctex_node_v(result);
+			}
+		}
+	}
+	return sum;
+}
+
+/* The best time of a few parses, 0 when the file could not be parsed */
+static double parse(const char * output, int threads, unsigned long * sum) {
+	synctex_parse_options_s options;
+	double best = 0;
+	int i;
+	memset(&options, 0, sizeof(options));
+	options.int_policy = synctex_parse_int_policy_request;
+	options.threads = threads;
+	for (i = 0; i < REPEAT; ++i) {
+		struct timespec start;
+		synctex_scanner_p scanner;
+		double elapsed;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		scanner = synctex_scanner_new_with_options(output, NULL, 1, &options);
+		elapsed = seconds_since(&start);
+		if (!scanner) {
+			return 0;
+		}
+		if (i == 0) {
+			*sum = checksum(scanner);
+		}
+		if (i == 0 || elapsed < best) {
+			best = elapsed;
+		}
+		synctex_scanner_free(scanner);
+	}
+	return best;
+}
+
+static int bench(const char * output, int max_threads) {
+	unsigned long expected = 0;
+	double reference = parse(output, 0, &expected);
+	int failed = 0;
+	int threads;
+	if (reference == 0) {
+		printf("%s: no synctex file\n", output);
+		return 1;
+	}
+	printf("%s\n", output);
+	printf("  sequential: %8.2f ms\n", reference * 1e3);
+	for (threads = 1; threads <= max_threads; threads *= 2) {
+		unsigned long sum = 0;
+		double elapsed = parse(output, threads, &sum);
+		printf("  %2d threads: %8.2f ms, speedup %5.2f%s\n", threads, elapsed * 1e3,
+			elapsed > 0 ? reference / elapsed : 0, sum == expected ? "" : ", DIFFERENT NODES");
+		failed |= sum != expected;
+	}
+	return failed;
+}
+
+int main(int argc, char ** argv) {
+	int max_threads = 8;
+	int failed = 0;
+	int i;
+	if (argc < 2) {
+		printf("Usage: %s output.pdf... [maximum number of threads]\n", argv[0]);
+		return 0;
+	}
+	if (argc > 2 && atoi(argv[argc - 1]) > 0) {
+		max_threads = atoi(argv[--argc]);
+	}
+	for (i = 1; i < argc; ++i) {
+		failed |= bench(argv[i], max_threads);
+	}
+	return failed;
+}
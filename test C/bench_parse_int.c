@@ -0,0 +1,101 @@
+// Compare the record decoder with the decimal integer policies.
+// Usage: bench_parse_int [number of records]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <synctex_parser_utils.h>
+
+#define FIELDS 7
+
+static char * make_records(int count, size_t * size) {
+	char * records = malloc(64 * (size_t)count + 1);
+	char * ptr = records;
+	int i;
+	if (!records) {
+		return NULL;
+	}
+	srand(1);
+	for (i = 0; i < count; i++) {
+		ptr += sprintf(ptr, "%i,%i:%i,%i:%i,%i,%i\n",
+			1 + rand() % 16, 1 + rand() % 5000,
+			rand() % 40000000, rand() % 50000000,
+			rand() % 30000000, rand() % 1000000, i % 7 ? 0 : -(rand() % 100000));
+	}
+	*size = ptr - records;
+	return records;
+}
+
+/* What the parser does field by field */
+static long decode_by_field(char * ptr, char * end, int * values) {
+	long sum = 0;
+	while (ptr < end) {
+		int i;
+		for (i = 0; i < FIELDS; i++) {
+			if (*ptr == ':' || *ptr == ',') {
+				++ptr;
+			}
+			values[i] = synctex_parse_int(ptr, &ptr);
+			sum += values[i];
+		}
+		++ptr;
+	}
+	return sum;
+}
+
+static long decode_by_record(char * ptr, char * end, int * values) {
+	char separators[FIELDS];
+	long sum = 0;
+	while (ptr < end) {
+		int i;
+		if (synctex_parse_int_fields(NULL, ptr, end, values, separators, FIELDS, &ptr) != FIELDS) {
+			return 0;
+		}
+		for (i = 0; i < FIELDS; i++) {
+			sum += values[i];
+		}
+		++ptr;
+	}
+	return sum;
+}
+
+static double bench(const char * name, long (*decode)(char *, char *, int *),
+		char * records, size_t size, int count, long * sum) {
+	int values[FIELDS];
+	clock_t start = clock();
+	int round;
+	for (round = 0; round < 10; round++) {
+		*sum = decode(records, records + size, values);
+	}
+	double ns = 1e9 * (double)(clock() - start) / CLOCKS_PER_SEC / 10 / count;
+	printf("%-8s %8.1f ns/record\n", name, ns);
+	return ns;
+}
+
+int main(int argc, char ** argv) {
+	int count = argc > 1 ? atoi(argv[1]) : 200000;
+	size_t size = 0;
+	char * records = make_records(count > 0 ? count : 1, &size);
+	long expected, sum;
+	int failed = 0;
+	if (!records) {
+		return 1;
+	}
+	synctex_parse_int_policy(synctex_parse_int_policy_C);
+	bench("C", decode_by_field, records, size, count, &expected);
+	synctex_parse_int_policy(synctex_parse_int_policy_raw1);
+	bench("raw1", decode_by_field, records, size, count, &sum);
+	failed |= sum != expected;
+	synctex_parse_int_policy(synctex_parse_int_policy_raw2);
+	bench("raw2", decode_by_field, records, size, count, &sum);
+	failed |= sum != expected;
+	bench("record", decode_by_record, records, size, count, &sum);
+	failed |= sum != expected;
+	if (failed) {
+		printf("X decoders do not agree\n");
+	}
+	free(records);
+	return failed;
+}
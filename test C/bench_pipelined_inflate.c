@@ -0,0 +1,96 @@
+// Parse compressed synctex files with and without inflating them
+// on another thread, compare the times and a checksum of the nodes.
+// Usage: bench_pipelined_inflate output.pdf...
+// The synctex file next to each output file is used.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <synctex_parser_advanced.h>
+
+#define REPEAT 5
+
+static double seconds_since(struct timespec * start) {
+	struct timespec stop;
+	clock_gettime(CLOCK_MONOTONIC, &stop);
+	return (stop.tv_sec - start->tv_sec) + (stop.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+/* A checksum of the nodes of all the sheets */
+static unsigned long checksum(synctex_scanner_p scanner) {
+	unsigned long sum = 0;
+	synctex_node_p sheet;
+	int page;
+	for (page = 1; (sheet = synctex_sheet(scanner, page)); ++page) {
+		synctex_node_p node = sheet;
+		while ((node = synctex_node_next(node))) {
+			sum = 31 * sum + (unsigned long)synctex_node_type(node);
+			sum = 31 * sum + (unsigned long)synctex_node_tag(node);
+			sum = 31 * sum + (unsigned long)synctex_node_line(node);
+			sum = 31 * sum + (unsigned long)synctex_node_h(node);
+			sum = 31 * sum + (unsigned long)synctex_node_v(node);
+			sum = 31 * sum + (unsigned long)synctex_node_width(node);
+		}
+	}
+	return sum;
+}
+
+/* The best time of a few parses, 0 when the file could not be parsed */
+static double parse(const char * output, int pipeline, unsigned long * sum) {
+	synctex_parse_options_s options;
+	double best = 0;
+	int i;
+	memset(&options, 0, sizeof(options));
+	options.int_policy = synctex_parse_int_policy_request;
+	options.pipeline = pipeline;
+	for (i = 0; i < REPEAT; ++i) {
+		struct timespec start;
+		synctex_scanner_p scanner;
+		double elapsed;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		scanner = synctex_scanner_new_with_options(output, NULL, 1, &options);
+		elapsed = seconds_since(&start);
+		if (!scanner) {
+			return 0;
+		}
+		if (i == 0) {
+			*sum = checksum(scanner);
+		}
+		if (i == 0 || elapsed < best) {
+			best = elapsed;
+		}
+		synctex_scanner_free(scanner);
+	}
+	return best;
+}
+
+static int bench(const char * output) {
+	unsigned long expected = 0, sum = 0;
+	double reference = parse(output, 0, &expected);
+	double elapsed;
+	if (reference == 0) {
+		printf("%s: no synctex file\n", output);
+		return 1;
+	}
+	elapsed = parse(output, 1, &sum);
+	printf("%s\n", output);
+	printf("  inflate then parse: %8.2f ms\n", reference * 1e3);
+	printf("  pipelined:          %8.2f ms, speedup %5.2f%s\n", elapsed * 1e3,
+		elapsed > 0 ? reference / elapsed : 0, sum == expected ? "" : ", DIFFERENT NODES");
+	return sum != expected;
+}
+
+int main(int argc, char ** argv) {
+	int failed = 0;
+	int i;
+	if (argc < 2) {
+		printf("Usage: %s output.pdf...\n", argv[0]);
+		return 0;
+	}
+	for (i = 1; i < argc; ++i) {
+		failed |= bench(argv[i]);
+	}
+	return failed;
+}
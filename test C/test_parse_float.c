@@ -0,0 +1,54 @@
+// synctex_parse_float must agree with strtod in the "C" locale,
+// whatever the current locale.
+
+#include <locale.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <synctex_parser_utils.h>
+
+static int failed = 0;
+
+void test(char * src, double expected, int length) {
+	char * end = NULL;
+	double result = synctex_parse_float(src, &end);
+	if (result == expected && end == src + length) {
+		printf("  %s = %g\n", src, expected);
+	}
+	else {
+		printf("X %s = %g (%i characters) != %g (%i characters)\n",
+			src, result, (int)(end - src), expected, length);
+		failed = 1;
+	}
+}
+
+void test_all(void) {
+	test("0", 0, 1);
+	test("1000", 1000, 4);
+	test("1.0", 1, 3);
+	test("1in", 1, 1);
+	test("-72.27pt", -72.27, 6);
+	test("+3.25bp", 3.25, 5);
+	test("   0.5cm", 0.5, 6);
+	test(".5mm", 0.5, 2);
+	test("5.sp", 5, 2);
+	test("1.5e-3dd", 1.5e-3, 6);
+	test("1e", 1, 1);
+	test("2E+2", 200, 4);
+	test("0.1", 0.1, 3);
+	test("65536.00001", 65536.00001, 11);
+	test("12345678901234567890", 12345678901234567890.0, 20);
+	test("-", 0, 0);
+	test(".e3", 0, 0);
+	test("pt", 0, 0);
+}
+
+int main(void) {
+	test_all();
+	/* A locale with a decimal comma, when available */
+	if (setlocale(LC_NUMERIC, "fr_FR.UTF-8") || setlocale(LC_NUMERIC, "de_DE.UTF-8")) {
+		printf("With a decimal comma:\n");
+		test_all();
+	}
+	return failed;
+}
@@ -0,0 +1,76 @@
+// Parse a synthetic synctex file with integer fields of more than 8 digits,
+// under a scanner integer policy that is not the process wide one.
+// The long fields of the records must be parsed with the policy of the scanner.
+// The synthetic file is created in the current directory, then removed.
+
+#include <stdio.h>
+#include <string.h>
+
+#include <synctex_parser_advanced.h>
+#include <synctex_parser_utils.h>
+
+#define OUTPUT "test_parse_int_policy.pdf"
+#define SYNCTEX "test_parse_int_policy.synctex"
+#define LONG_FIELD "99999999999"
+
+static int write_synctex(void) {
+	FILE * F = fopen(SYNCTEX, "wb");
+	if (!F) {
+		return 1;
+	}
+	fprintf(F, "SyncTeX Version:1\n");
+	fprintf(F, "Input:1:/synthetic/main.tex\n");
+	fprintf(F, "Output:pdf\nMagnification:1000\nUnit:1\nX Offset:0\nY Offset:0\nContent:\n");
+	fprintf(F, "{1\n");
+	fprintf(F, "[1,1:0,0:4000000,6000000,0\n");
+	fprintf(F, "(1,2:100000,200000:3000000,400000,100000\n");
+	fprintf(F, "k1,3:" LONG_FIELD ",200000:20000\n");
+	fprintf(F, ")\n]\n}1\n");
+	fprintf(F, "Postamble:\nCount:4\nPost scriptum:\n");
+	return fclose(F) != 0;
+}
+
+/* The h of the kern parsed with the given policies, 0 if there is none */
+static int kern_h(synctex_parse_int_policy_t global, synctex_parse_int_policy_t policy) {
+	synctex_parse_options_s options;
+	synctex_scanner_p scanner;
+	synctex_node_p node;
+	int h = 0;
+	memset(&options, 0, sizeof(options));
+	options.int_policy = policy;
+	synctex_parse_int_policy(global);
+	scanner = synctex_scanner_new_with_options(OUTPUT, NULL, 1, &options);
+	for (node = synctex_sheet(scanner, 1); node; node = synctex_node_next(node)) {
+		if (synctex_node_type(node) == synctex_node_type_kern) {
+			h = synctex_node_h(node);
+			break;
+		}
+	}
+	synctex_scanner_free(scanner);
+	return h;
+}
+
+static int test(synctex_parse_int_policy_t global, synctex_parse_int_policy_t policy) {
+	char field[] = LONG_FIELD;
+	int expected = (*synctex_parse_int_function(policy))(field, NULL);
+	int h = kern_h(global, policy);
+	if (h == expected) {
+		printf("  policy %i, process wide %i: %s = %i\n", policy, global, field, h);
+		return 0;
+	}
+	printf("X policy %i, process wide %i: %s = %i != %i\n", policy, global, field, h, expected);
+	return 1;
+}
+
+int main(void) {
+	int failed = 0;
+	if (write_synctex()) {
+		printf("Can't create %s\n", SYNCTEX);
+		return 1;
+	}
+	failed |= test(synctex_parse_int_policy_raw2, synctex_parse_int_policy_C);
+	failed |= test(synctex_parse_int_policy_C, synctex_parse_int_policy_raw2);
+	remove(SYNCTEX);
+	synctex_parse_int_policy(synctex_parse_int_policy_C);
+	return failed;
+}